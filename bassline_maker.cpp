@@ -1,26 +1,49 @@
 #include "bassline_maker.h"
+#include "parallel_search.h"
+#include "fragment_index.h"
+#include "reachability.h"
+#include "refinement.h"
+
+uint8_t msc::OutputData::keyIndex(const Key* key) {
+	auto keyIt = std::ranges::find(keys, key);
+	if (keyIt == keys.end()) {
+		keys.push_back(key);
+		return static_cast<uint8_t>(keys.size() - 1);
+	}
+	return static_cast<uint8_t>(keyIt - keys.begin());
+}
 
-std::optional<int> msc::ChordTree::ChordNode::legalBassPitch(Key& key, const Chord& destination) {
-	Note bass = destination.notes[static_cast<size_t>(destination.inversion)]; //widening conversion
+void msc::OutputData::append(OutputData&& other) {
+	if (steps.empty() && keys.empty()) {
+		*this = std::move(other);
+		return;
+	}
 
-	//the soprano and bass should never have the same note
-	if (bass.name == sopranoLine[noteIdx + 1].name && 
-		writtenBaseNotes.back().name == sopranoLine[noteIdx].name)
-	{
-		return {};
+	//the key indices of other point into its own keys
+	std::vector<uint8_t> keyIndices;
+	for (const Key* key : other.keys) {
+		keyIndices.push_back(keyIndex(key));
+	}
+	for (SolutionStep step : other.steps) {
+		step.keyIdx = keyIndices[step.keyIdx];
+		steps.push_back(step);
 	}
+}
 
-	//resolve the leading tone
-	Note leadingTone = key[6].lock()->notes[0];
-	Note tonic = key[0].lock()->notes[0];
+msc::Note msc::ChordTree::ChordNode::writtenBass(const Key& key) {
+	if (steps.empty()) {
+		return startBass;
+	}
+	const SolutionStep& step = steps.back();
+	return { key.chordOfId(step.chordId, step.inversion).notes[step.inversion].name, step.pitch, step.duration };
+}
 
-	bool leadingToneResolutionNeed = false;
+std::optional<int> msc::ChordTree::ChordNode::legalBassPitch(const Key& key, const Chord& destination) {
+	MSC_TRACE_SPAN("bass rules");
+	Note bass = destination.notes[static_cast<size_t>(destination.inversion)]; //widening conversion
+	Note previousBass = writtenBass(key);
 
-	if (writtenBaseNotes.back().name == leadingTone.name) {
-		std::cout << writtenBaseNotes.back().name << " needs to resolve to " << tonic.name << std::endl;
-		leadingToneResolutionNeed = true;
-	}
-	if (leadingToneResolutionNeed && bass.name != tonic.name) {
+	if (bassNameViolation(key, previousBass, sopranoLine[noteIdx], bass, sopranoLine[noteIdx + 1]).has_value()) {
 		return {};
 	}
 
@@ -33,259 +56,459 @@ std::optional<int> msc::ChordTree::ChordNode::legalBassPitch(Key& key, const Cho
 		if (bass.pitch > HIGHEST_BASS_PITCH) { //when we have tried every single legal pitch
 			break;
 		}
-		if (bass.pitch < LOWEST_BASS_PITCH) { //keep moving note up an octave if it is too low
-			continue;
-		}
-	
-		if (std::abs(bass.pitch - writtenBaseNotes.back().pitch) > LARGEST_BASS_LEAP) {
-			continue;
-		}
-		int bassInterval = bass.pitch - writtenBaseNotes.back().pitch;
-		if (std::abs(bassInterval) == 6) { //forbid tritone
-			continue;
-		}
-		if (leadingToneResolutionNeed) {
-			if (bassInterval != 1) {
-				continue;
-			}
-		}
-	
-		//chordal seventh resolution test
-		if (m_chord->inversion == 3) {
-			if (bassInterval != -1) {
-				continue;
-			}
+		if (!bassPitchViolation(key, *m_chord, previousBass, sopranoInterval, bass).has_value() && 
+			(span == nullptr || span->isLive(noteIdx + 1, destination, bass.pitch))) 
+		{
+			return bass.pitch;
 		}
-
-		if (bassInterval == sopranoInterval && sopranoInterval == 7) { //if we have parallel fifths
-			continue;
-		} 
-
-		return bass.pitch;
 	}
 
 	return {};
 }
 
 bool msc::ChordTree::ChordNode::validInversion() {
-	if (noteIdx == sopranoLine.size() - 1 && m_chord->inversion != 0) { //always make the last chord in root position
-		return false;
+	MSC_TRACE_SPAN("inversion rules");
+	return !inversionViolation(*m_chord, previous->m_chord->degree, noteIdx == sopranoLine.size() - 1).has_value();
+}
+
+void msc::ChordTree::ChordNode::generateDestinations(const Key* key) {
+	MSC_TRACE_SPAN("candidate generation");
+	MSC_TRACE_NODE();
+
+	//chords that can follow this one and contain the next soprano note
+	ChordSet candidates = key->candidates(*m_chord, sopranoLine[noteIdx + 1]);
+
+	//make a node for every inversion of each chord, pointing at the key's copy of it
+	for (size_t id = 0; id < key->chordCount(); id++) {
+		if (!candidates.test(id)) {
+			continue;
+		}
+		for (size_t i = 0; i < key->chordOfId(id).notes.size(); i++) {
+			destinations.push_back(&nodes.emplace_back(&key->chordOfId(id, static_cast<int>(i)), noteIdx + 1));
+		}
 	}
+}
 
-	//notes preceeded by a 6 chord must be in root position
-	if (previous->m_chord->degree == 6 && m_chord->inversion != 0) {
+bool msc::ChordTree::followFragment() {
+	if (ChordNode::fragments == nullptr) {
 		return false;
 	}
 
-	if (previous->m_chord->degree == SECONDARY_DOM_DEGREE && m_chord->inversion == 3) {
+	size_t goalIdx = m_sentinel->noteIdx + ChordNode::chordCountGoal;
+	auto moves = ChordNode::fragments->moves(*m_key, ChordNode::sopranoLine, m_cursor->noteIdx, *m_cursor->m_chord, 
+		                                     ChordNode::writtenBass(*m_key), goalIdx, m_endCondition);
+	if (ChordNode::span != nullptr) { //fragments that pass through a dead state are dropped
+		std::erase_if(moves, [this](const std::vector<SolutionStep>& move) {
+			for (size_t i = 0; i < move.size(); i++) {
+				const Chord& chord = m_key->chordOfId(move[i].chordId, move[i].inversion);
+				if (!ChordNode::span->isLive(m_cursor->noteIdx + i + 1, chord, move[i].pitch)) {
+					return true;
+				}
+			}
+			return false;
+		});
+	}
+	if (m_cursor->triedFragments >= moves.size()) {
 		return false;
 	}
 
-	switch (m_chord->degree) {
-	case -1: 
-		return m_chord->inversion != THIRD; //no V of V chords with a 7th allowed
-		break;
-	case 1:
-		//6/4  and 3rd inversion 1 chords are banned!
-		return m_chord->inversion != SECOND && m_chord->inversion != THIRD;
-		break;
-	case 4:
-		return m_chord->inversion != THIRD; //no 4 chords with a 7th
-		break;
-	case 6:
-		//six chord in first inversion must be preceeded by a V/V
-		if (m_chord->inversion == FIRST) {
-			return previous->m_chord->degree == SECONDARY_DOM_DEGREE;
-		} else { //otherwise, a 6 chord must be in root position
-			return m_chord->inversion == ROOT && previous->m_chord->degree != SECONDARY_DOM_DEGREE;
-		}
-		break;
-	case 7:
-		return m_chord->degree == FIRST; //seventh chords must be in 1st inversion
-		break;
+	//the fragment becomes a chain of nodes, which are backtracked through like any other
+	for (const SolutionStep& step : moves[m_cursor->triedFragments++]) {
+		ChordNode* node = &ChordNode::nodes.emplace_back(&m_key->chordOfId(step.chordId, step.inversion), m_cursor->noteIdx + 1);
+		node->previous = m_cursor;
+		m_cursor = node;
+		ChordNode::steps.push_back(step);
 	}
-
 	return true;
 }
 
-std::vector<msc::ChordTree::ChordNode*> msc::ChordTree::ChordNode::generateDestinations(Key* key) {
-	std::vector<ChordNode*> ret;
+bool msc::ChordTree::explore() {
+	//each pass of the loop either moves the cursor forward, backtracks, or rules out a destination
+	while (ChordNode::steps.size() < ChordNode::chordCountGoal) {
+		//ChordNode* current = m_cursor;
+		if (m_cursor == nullptr || ChordNode::stop.stop_requested()) {
+			return false;
+		}
 
-	std::vector<Chord*> chordDestinations;
-	
-	//Chord factory 
-	auto makeChordWithInversion = [](Chord* chord, int inversion) {
-		Chord* inverted = new Chord(*chord);
-		inverted->inversion = inversion;
-		return inverted;
-	};
+		//known fragments go first, then single moves
+		if (!m_cursor->generatedDestinations && followFragment()) {
+			continue;
+		}
 
-	auto destinations = key->possibleChords(std::vector{ sopranoLine[noteIdx + 1] });
+		//generate destinations if we haven't already
+		if (!m_cursor->generatedDestinations) {
+			m_cursor->generateDestinations(m_key);
+			m_cursor->generatedDestinations = true;
+		}
 
-	const auto& legalChordMoves = m_chord->destinations;
+		//put unexplored destinations in a vector
+		std::vector<ChordNode*> unexploredDestinations;
 
-	//for each chord, push back a chord with all possible inversions
-	for (std::weak_ptr<Chord> dest : destinations) {
-		if (std::find_if(legalChordMoves.begin(), legalChordMoves.end(),
-			[dest](Chord* chord) { return chord->degree == dest.lock().get()->degree; }) != legalChordMoves.end())
-		{
-			for (int i = 0; i < 4; i++) {
-				chordDestinations.push_back(makeChordWithInversion(dest.lock().get(), i));
+		for (ChordNode* node : m_cursor->destinations) {
+			if (!node->explored) {
+				unexploredDestinations.push_back(node);
 			}
 		}
-	}
 
-	//make new nodes from chords
-	for (Chord* chord : chordDestinations) {
-		ret.push_back(new ChordNode{ chord, true, noteIdx + 1 });
-	}
+		//if there are no legal chord moves, backtrack
+		if (unexploredDestinations.size() == 0) { 
+			MSC_TRACE_SPAN("backtrack");
+			m_cursor->explored = true;
+			if (m_cursor != m_sentinel) { //the start chord isn't part of the path
+				ChordNode::steps.pop_back();
+			}
+			m_cursor = m_cursor->previous;
+			continue;
+		}
 
-	return ret;
-}
+		//random number device, generator, and distibution to pick a random element from unexploredDestinations
+		static thread_local std::random_device dev;
+		static thread_local std::mt19937 rng(dev());
+		std::uniform_int_distribution<size_t> dist(0, unexploredDestinations.size() - 1);
 
-void msc::ChordTree::explore() {
-	//ChordNode* current = m_cursor;
-	if (m_cursor == nullptr) {
-		std::cout << "I couldn't solve this one.\n";
-		exit(0);
-	}
+		size_t randomDestIdx = dist(rng);
+		
+		//pick a random destination
+		ChordNode* randomDest = unexploredDestinations[randomDestIdx];
+		randomDest->previous = m_cursor; 
 
-	//generate destinations if we haven't already
-	if (!m_cursor->generatedDestinations) {
-		m_cursor->destinations = m_cursor->generateDestinations(m_key);
-		m_cursor->generatedDestinations = true;
-	}
+		if (!randomDest->validInversion()) {
+			randomDest->explored = true;
+			continue;
+		} 
 
-	//put unexplored destinations in a vector
-	std::vector<ChordNode*> unexploredDestinations;
+		auto pitch = m_cursor->legalBassPitch(*m_key, *randomDest->m_chord);
 
-	for (ChordNode* node : m_cursor->destinations) {
-		if (!node->explored) {
-			unexploredDestinations.push_back(node);
+		if (!pitch.has_value()) {
+			randomDest->explored = true;
+			continue;
+		}
+
+		//the last chord has to satisfy the end condition, if there is one
+		bool lastChord = ChordNode::steps.size() + 1 == ChordNode::chordCountGoal;
+		if (lastChord && m_endCondition && !m_endCondition(*randomDest->m_chord, pitch.value())) {
+			randomDest->explored = true;
+			continue;
 		}
+
+		m_cursor = randomDest;
+		
+		//add note to bassline
+		ChordNode::steps.emplace_back(static_cast<uint8_t>(randomDest->m_chord->id), static_cast<uint8_t>(randomDest->m_chord->inversion), 
+			                          static_cast<uint8_t>(pitch.value()), 0, ChordNode::sopranoLine[randomDest->noteIdx].duration);
 	}
 
-	//if there are no legal chord moves, backtrack
-	if (unexploredDestinations.size() == 0) { 
-		std::cout << "backtracking\n";
-		m_cursor->explored = true;
-		m_cursor = m_cursor->previous;
-		ChordNode::writtenBaseNotes.pop_back();
-		ChordNode::chords.pop_back();
-		explore();
-		return;
+	return true;
+}
+
+std::optional<msc::OutputData> msc::ChordTree::getPath() 
+{
+	if (!explore()) {
+		return {};
 	}
 
-	//random number device, generator, and distibution to pick a random element from unexploredDestinations
-	static std::random_device dev;
-	static std::mt19937 rng(dev());
-	std::uniform_int_distribution<size_t> dist(0, unexploredDestinations.size() - 1);
+	OutputData data;
+	data.steps = std::move(ChordNode::steps);
+	data.keys = { m_key };
+	ChordNode::steps.clear(); //moved from vectors are valid but unspecified
+	return data;
+}
 
-	size_t randomDestIdx = dist(rng);
-	
-	//pick a random destination
-	ChordNode* randomDest = unexploredDestinations[randomDestIdx];
-	randomDest->previous = m_cursor; 
+msc::ChordTree::ChordTree(const Key* key, std::span<const Note> sopranoLine, Note firstBassNote, const Chord* chord, 
+						  size_t startSopranoNoteIdx, size_t chordCountGoal, EndCondition endCondition, 
+						  const FragmentIndex* fragments, const KeySpan* span, std::stop_token stop) 
+{
+	m_key = key;
+	m_endCondition = std::move(endCondition);
 
-	if (!randomDest->validInversion()) {
-		randomDest->explored = true;
-		explore();
-		return;
-	} 
+	//a thread may solve several trees, one after another
+	ChordNode::nodes.clear();
+	ChordNode::steps.clear();
 
-	auto pitch = m_cursor->legalBassPitch(*m_key, *randomDest->m_chord);
+	m_sentinel = &ChordNode::nodes.emplace_back(chord, startSopranoNoteIdx);
+	m_cursor = m_sentinel;
 
-	if (!pitch.has_value()) {
-		randomDest->explored = true;
-		explore();
-		return;
+	ChordNode::startBass = firstBassNote; //set first bass note
+	ChordNode::chordCountGoal = chordCountGoal;
+	ChordNode::sopranoLine = sopranoLine;
+	ChordNode::fragments = fragments;
+	ChordNode::span = span != nullptr && span->liveStates != nullptr ? span : nullptr;
+	ChordNode::stop = std::move(stop);
+}
+
+std::vector<msc::Note> msc::collapseHarmonicRhythm(std::span<const Note> sopranoLine, int slotLength, int startTime) {
+	std::vector<Note> collapsed;
+
+	int onset = 0;
+	for (const Note& note : sopranoLine) {
+		/*a note joins the previous slot if it starts inside of it. Slots that start before startTime
+		are left alone so that the slots line up with the end of the pre-given bassline*/
+		int slotOnset = collapsed.empty() ? 0 : onset - collapsed.back().duration;
+		bool sameSlot = !collapsed.empty() && slotOnset >= startTime && (onset / slotLength) == (slotOnset / slotLength);
+		if (sameSlot) {
+			collapsed.back().duration += note.duration;
+		} else {
+			collapsed.push_back(note);
+		}
+		onset += note.duration;
 	}
 
-	m_cursor = randomDest;
-	
-	//add note to bassline
-	ChordNode::writtenBaseNotes.push_back(
-		{ randomDest->m_chord->notes[randomDest->m_chord->inversion].name, pitch.value(), 
-		  ChordNode::sopranoLine[randomDest->noteIdx].duration }
-	);
-	ChordNode::chords.push_back(*randomDest->m_chord);
+	return collapsed;
+}
 
-	if (ChordNode::writtenBaseNotes.size() == ChordNode::chordCountGoal) {
-		return;
-	} else {
-		explore();
-		return;
+bool msc::acceptsSpanEnd(const KeySpan& span, const std::optional<BassState>& pin, const Chord& chord, int pitch) {
+	if (span.waypoint.has_value() && (chord.degree != span.waypoint->degree || 
+		(span.waypoint->inversion.has_value() && chord.inversion != span.waypoint->inversion.value()))) 
+	{
+		return false;
+	}
+	if (pin.has_value() && (chord.degree != pin->chord.degree || chord.inversion != pin->chord.inversion || pitch != pin->bass.pitch)) {
+		return false;
 	}
+	return span.nextKey == nullptr || span.nextKey->pivotChord(chord) != nullptr;
 }
 
-msc::OutputData msc::ChordTree::getPath() 
+std::optional<msc::OutputData> msc::solveSpan(const KeySpan& span, std::span<const Note> sopranoLine, const Note& startBass, 
+	                                           const Chord& startChord, std::optional<BassState> endState, 
+	                                           const FragmentIndex* fragments, std::stop_token stop)
 {
-	explore();
-
-	//erase the data that was not written
-	auto& bassLine = ChordTree::ChordNode::writtenBaseNotes;
-	bassLine.erase(bassLine.begin()); 
-	auto& chords = ChordTree::ChordNode::chords;
-	chords.erase(chords.begin());
+	//the last chord has to match the waypoint and the pinned end state, and pivot into the next key
+	EndCondition endCondition;
+	if (span.nextKey != nullptr || span.waypoint.has_value() || endState.has_value()) {
+		endCondition = [&span, endState](const Chord& chord, int pitch) {
+			return acceptsSpanEnd(span, endState, chord, pitch);
+		};
+	}
 
-	return std::make_pair(bassLine, chords);
+	MSC_TRACE_SPAN("search");
+	ChordTree chordTree{ span.key, sopranoLine, startBass, &startChord, span.startIdx, span.endIdx - span.startIdx, endCondition, 
+	                     fragments, &span, std::move(stop) };
+	return chordTree.getPath();
 }
 
-msc::ChordTree::ChordTree(Key* key, std::vector<Note>& sopranoLine, Note firstBassNote, Chord* chord, 
-						  size_t startSopranoNoteIdx, size_t chordCountGoal) 
+std::optional<msc::OutputData> msc::solveKeySpans(const std::vector<KeySpan>& spans, std::span<const Note> sopranoLine, 
+	                                              const BassState& start, const std::vector<std::optional<BassState>>& pins, 
+	                                              const SearchOptions& options)
 {
-	m_key = key;
+	//groups of spans that start from a known state: the given start, or a pinned pivot
+	std::vector<std::pair<size_t, BassState>> groupStarts{ { 0, start } };
+	for (size_t i = 0; i + 1 < spans.size(); i++) {
+		if (pins[i].has_value()) {
+			BassState pivot = pins[i].value();
+			if (spans[i].nextKey != nullptr) {
+				pivot.chord = *spans[i].nextKey->pivotChord(pins[i]->chord);
+				pivot.chord.inversion = pins[i]->chord.inversion;
+			}
+			groupStarts.emplace_back(i + 1, pivot);
+		}
+	}
 
-	m_sentinel = new ChordNode{ chord, true, startSopranoNoteIdx };
-	m_cursor = m_sentinel;
-	
-	ChordNode::writtenBaseNotes.push_back(firstBassNote); //set first bass note
-	ChordNode::chords.push_back(*chord); //set first chord
-	ChordNode::chordCountGoal = chordCountGoal + 1; //we add one because the starting chord does not count
-	ChordNode::sopranoLine = sopranoLine;
+	//solves the spans of one group in order. Each span continues from the last chord of the previous one
+	auto solveGroup = [&](size_t groupIdx) -> std::optional<OutputData> {
+		size_t firstSpan = groupStarts[groupIdx].first;
+		size_t endSpan = groupIdx + 1 < groupStarts.size() ? groupStarts[groupIdx + 1].first : spans.size();
+
+		//the search is random, so a group whose later span can't continue from an earlier one is tried again
+		for (int attempt = 0; attempt < MAX_SPAN_ATTEMPTS; attempt++) {
+			OutputData group;
+			BassState current = groupStarts[groupIdx].second;
+			bool solved = true;
+
+			for (size_t i = firstSpan; i < endSpan; i++) {
+				auto endState = i + 1 == endSpan && i + 1 < spans.size() ? pins[i] : std::nullopt;
+				auto data = options.threads > 1 
+					      ? solveSpanParallel(spans[i], sopranoLine, current.bass, current.chord, endState, options.threads, 
+							                  options.fragments, options.stop)
+					      : solveSpan(spans[i], sopranoLine, current.bass, current.chord, endState, options.fragments, options.stop);
+				if (!data.has_value()) {
+					solved = false;
+					break;
+				}
+				//carry the last chord into the next key
+				current = { data->chord(data->size() - 1), data->bassNote(data->size() - 1) };
+				group.append(std::move(data.value()));
+				if (spans[i].nextKey != nullptr) {
+					int inversion = current.chord.inversion;
+					current.chord = *spans[i].nextKey->pivotChord(current.chord);
+					current.chord.inversion = inversion;
+				}
+			}
+
+			if (solved) {
+				return group;
+			}
+		}
+
+		return {};
+	};
+
+	//groups share no state, so they are solved concurrently
+	std::vector<std::future<std::optional<OutputData>>> groupFutures;
+	for (size_t i = 1; i < groupStarts.size(); i++) {
+		groupFutures.push_back(std::async(std::launch::async, solveGroup, i));
+	}
+
+	auto data = solveGroup(0);
+	for (auto& future : groupFutures) {
+		auto group = future.get();
+		if (!data.has_value() || !group.has_value()) {
+			data = std::nullopt;
+			continue;
+		}
+		data->append(std::move(group.value()));
+	}
+
+	return data;
 }
 
-msc::OutputData msc::writeBassLine(Key& key, std::vector<Note>& sopranoLine, std::vector<Note>& bassLine, int finalDegree)
+std::optional<msc::BassLinePlan> msc::planBassLine(const std::vector<KeySegment>& keys, std::span<const Note> sopranoLine, 
+	                                                std::span<const Note> bassLine, int finalDegree, int harmonicRhythm, 
+	                                                const std::vector<HarmonyLabel>& waypoints)
 {
+	BassLinePlan plan;
+
 	int preBassLineLength = 0; //# of beats the pre-given bassline goes for
 	for (int i = 0; i < bassLine.size(); i++) {
 		preBassLineLength += bassLine[i].duration;
 	}
 
-	size_t lastBassNoteIdx = bassLine.size() - 1; //index of the final bass note
+	//harmonize one chord per slot instead of one chord per soprano note
+	plan.sopranoLine = sopranoLine;
+	if (harmonicRhythm > 0) {
+		plan.collapsedLine = collapseHarmonicRhythm(sopranoLine, harmonicRhythm, preBassLineLength);
+	}
+	std::span<const Note> harmonizedLine = plan.harmonizedLine();
 
 	//start writing bassline where the given bassline ends
 	size_t startSopranoNoteIdx = 0;
 	int beatCount = 0;
-	for (startSopranoNoteIdx; startSopranoNoteIdx < sopranoLine.size(); startSopranoNoteIdx++) {
-		beatCount += sopranoLine[startSopranoNoteIdx].duration;
+	for (startSopranoNoteIdx; startSopranoNoteIdx < harmonizedLine.size(); startSopranoNoteIdx++) {
+		beatCount += harmonizedLine[startSopranoNoteIdx].duration;
 		if (beatCount == preBassLineLength) {
 			break;
 		} else if (beatCount > preBassLineLength) {
 			std::cout << "Error: pre-given bassline must end in alignment with soprano voice\n";
-			exit(0);
+			return {};
 		}
 	}
 
-	/*# of notes we hope to have in our path. This is equal to the # of notes
-	between the first unacompannied soprano note to the last soprano note (inclusive)*/
-	size_t nodeTraversalGoal = (sopranoLine.size() - 1) - startSopranoNoteIdx;
-	//std::cout << "soprano notes: " << sopranoLine.size() << std::endl;
+	//maps an index of the written soprano line to the index of the harmonized note that contains it
+	auto harmonizedIdx = [&](size_t noteIdx) {
+		int onset = 0;
+		for (size_t i = 0; i < noteIdx && i < sopranoLine.size(); i++) {
+			onset += sopranoLine[i].duration;
+		}
+		size_t idx = 0;
+		for (int slotEnd = harmonizedLine[0].duration; slotEnd <= onset && idx + 1 < harmonizedLine.size(); slotEnd += harmonizedLine[idx].duration) {
+			idx++;
+		}
+		return idx;
+	};
 
-	std::vector<Note> lastChordNotes; //final notes written before blank bassline
-	if (preBassLineLength > 0) {
-		std::cout << "last bass note index: " << lastBassNoteIdx << std::endl;
-		//std::cout << "Vector size: " << bassLine.size() << std::endl;
-		lastChordNotes = { bassLine[lastBassNoteIdx], sopranoLine[startSopranoNoteIdx] };
-	} else {
-		lastChordNotes = { sopranoLine[startSopranoNoteIdx] };
+	/*split the unwritten notes into one span per key. Each span starts at the note before it, whose 
+	chord is already written, and ends at the last note of its key*/
+	std::vector<KeySpan>& spans = plan.spans;
+	const Key* startKey = keys.front().key.get(); //key of the last given chord
+	for (size_t i = 0; i < keys.size(); i++) {
+		size_t segmentStart = harmonizedIdx(keys[i].noteIdx);
+		size_t segmentEnd = i + 1 < keys.size() ? harmonizedIdx(keys[i + 1].noteIdx) : harmonizedLine.size();
+		if (segmentStart <= startSopranoNoteIdx) {
+			startKey = keys[i].key.get();
+		}
+		//skip segments that are covered by the given bassline, or that are empty after collapsing
+		if (segmentEnd <= startSopranoNoteIdx + 1 || segmentEnd <= segmentStart) { 
+			continue;
+		}
+		if (!spans.empty()) {
+			spans.back().nextKey = keys[i].key.get();
+		}
+		spans.push_back({ .key = keys[i].key.get(), .startIdx = std::max(segmentStart, startSopranoNoteIdx + 1) - 1, 
+			              .endIdx = segmentEnd - 1, .nextKey = nullptr, .waypoint = {}, .liveStates = nullptr });
 	}
 
-	auto startChord = key[finalDegree - 1];
+	/*a chord label on a soprano note is a waypoint. The span it falls in ends there, and the rest of the 
+	span goes on from it*/
+	std::vector<HarmonyLabel> sortedWaypoints{ waypoints.begin(), waypoints.end() };
+	std::ranges::stable_sort(sortedWaypoints, {}, &HarmonyLabel::noteIdx);
+	for (HarmonyLabel waypoint : sortedWaypoints) {
+		waypoint.noteIdx = harmonizedIdx(waypoint.noteIdx);
+		auto spanIt = std::ranges::find_if(spans, [&waypoint](const KeySpan& span) {
+			return span.startIdx < waypoint.noteIdx && waypoint.noteIdx <= span.endIdx;
+		});
+		//the note is already written, or already has a waypoint (it shares a chord slot with an earlier one)
+		if (spanIt == spans.end() || (spanIt->endIdx == waypoint.noteIdx && spanIt->waypoint.has_value())) {
+			continue;
+		}
+		if (spanIt->key->chordOfDegree(waypoint.degree) == nullptr) {
+			std::cout << "Error: the chord labeled on soprano note " << waypoint.noteIdx << " is not in its key\n";
+			return {};
+		}
+
+		if (waypoint.noteIdx < spanIt->endIdx) {
+			KeySpan rest = *spanIt;
+			rest.startIdx = waypoint.noteIdx;
+			spanIt->endIdx = waypoint.noteIdx;
+			spanIt->nextKey = nullptr;
+			spanIt = spans.insert(spanIt + 1, rest) - 1;
+		}
+		spanIt->waypoint = waypoint;
+	}
 
-	ChordTree chordTree{ &key, sopranoLine, bassLine.back(), startChord.lock().get(), startSopranoNoteIdx, nodeTraversalGoal };
+	//the given bassline ends with the final chord of the key it is written in
+	const Chord* startChordPtr = startKey->chordOfDegree(finalDegree);
+	if (startChordPtr == nullptr || spans.empty()) {
+		spans.clear();
+		return plan;
+	}
+	BassState& start = plan.start;
+	start = { *startChordPtr, bassLine.back() };
+	if (startKey != spans.front().key) { //the first unwritten note is in a new key
+		const Chord* pivot = spans.front().key->pivotChord(start.chord);
+		if (pivot == nullptr) {
+			std::cout << "Error: the final chord of the given bassline is not in the next key\n";
+			return {};
+		}
+		start.chord = *pivot;
+	}
 
-	auto data = chordTree.getPath();
-	
-	return data;
-}
\ No newline at end of file
+	plan.pins.resize(spans.size());
+	return plan;
+}
+
+std::optional<msc::OutputData> msc::solvePlan(BassLinePlan& plan, const SearchOptions& options) {
+	//a hopeless plan is caught in linear time, before the search tries every path through it
+	if (auto conflict = findConflict(plan)) {
+		printConflict(conflict.value(), plan.harmonizedLine());
+		return {};
+	}
+
+	//the state at each waypoint is fixed along a path that reaches the end, so the spans between them don't depend on each other
+	bool hasWaypoints = std::ranges::any_of(plan.spans, [](const KeySpan& span) { return span.waypoint.has_value(); });
+	if (hasWaypoints && !pinWaypoints(plan)) {
+		std::cout << "Error: no bassline follows the rules through every labeled chord\n";
+		return {};
+	}
+
+	auto solution = solveKeySpans(plan.spans, plan.harmonizedLine(), plan.start, plan.pins, options);
+	if (!solution.has_value() || options.refineTime.count() <= 0) {
+		return solution;
+	}
+
+	return refineBassLine(plan, solution.value(), options);
+}
+
+std::optional<msc::OutputData> msc::writeBassLine(const std::vector<KeySegment>& keys, std::span<const Note> sopranoLine, 
+	                                              std::span<const Note> bassLine, int finalDegree, int harmonicRhythm, 
+	                                              const std::vector<HarmonyLabel>& waypoints, const SearchOptions& options)
+{
+	MSC_TRACE_SPAN("write bassline");
+
+	auto plan = planBassLine(keys, sopranoLine, bassLine, finalDegree, harmonicRhythm, waypoints);
+	if (!plan.has_value()) {
+		return {};
+	} else if (plan->spans.empty()) { //nothing is left to write
+		return OutputData{};
+	}
+
+	return solvePlan(plan.value(), options);
+}
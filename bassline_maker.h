@@ -2,42 +2,103 @@
 
 #include <random>
 #include <optional>
+#include <functional>
+#include <future>
+#include <span>
+#include <deque>
+#include <chrono>
+#include <stop_token>
+#include <cstdint>
 
 #include "types.h"
+#include "rules.h"
 
 namespace msc {
-	using OutputData = std::pair<std::vector<Note>, std::vector<Chord>>;
+	class FragmentIndex;
+	struct KeySpan;
+
+	//a written chord and bass note, packed so a solution takes 8 bytes a note
+	struct SolutionStep {
+		uint8_t chordId = 0; //position of the chord in the vocabulary of its key
+		uint8_t inversion = 0;
+		uint8_t pitch = 0;   //of the bass note
+		uint8_t keyIdx = 0;  //index into OutputData::keys
+		int32_t duration = 0;
+	};
+
+	/*the written bassline. The chords and bass notes are looked up from the keys when they are needed, 
+	and the whole thing is moved rather than copied from the search to the writers*/
+	class OutputData {
+	public:
+		std::vector<SolutionStep> steps;
+		std::vector<const Key*> keys; //every key the steps are in
+
+		OutputData() = default;
+		OutputData(OutputData&&) = default;
+		OutputData& operator=(OutputData&&) = default;
+		OutputData(const OutputData&) = delete;
+		OutputData& operator=(const OutputData&) = delete;
+
+		inline size_t size() const {
+			return steps.size();
+		}
+		inline const Key& key(size_t idx) const {
+			return *keys[steps[idx].keyIdx];
+		}
+		inline const Chord& chord(size_t idx) const {
+			return key(idx).chordOfId(steps[idx].chordId, steps[idx].inversion);
+		}
+		inline Note bassNote(size_t idx) const {
+			return { chord(idx).notes[steps[idx].inversion].name, steps[idx].pitch, steps[idx].duration };
+		}
+
+		//returns the index of key in keys, adding it if it isn't there yet
+		uint8_t keyIndex(const Key* key);
+
+		//moves the steps of other onto the end of this solution
+		void append(OutputData&& other);
+	};
+
+	//checked against the last chord of a path and the pitch of its bass note
+	using EndCondition = std::function<bool(const Chord&, int)>;
 
 	class ChordTree {
 	private:
 		//size_t m_endSopranoNoteIdx = 0;
 
 		struct ChordNode {
-			Chord* m_chord;
-
-			bool ownedByTree = false; //flags whether the node should be deleted when the chord tree is destroyed
+			const Chord* m_chord; //an inverted chord owned by the key, or the start chord of the tree
 
 			size_t noteIdx = 0;//current index of the soprano line
 
-			static inline size_t chordCountGoal = 0; //the # of chords we need to have in the bass line
-			static inline std::vector<Note> sopranoLine; //non-owning
-			static inline std::vector<Note> writtenBaseNotes;
-			static inline std::vector<Chord> chords;
+			//the search state is per thread so that independent trees can be solved concurrently
+			static inline thread_local size_t chordCountGoal = 0; //the # of chords we need to have in the bass line
+			static inline thread_local std::span<const Note> sopranoLine; //non-owning
+			static inline thread_local Note startBass; //the bass note under the start chord, which isn't written
+			static inline thread_local std::vector<SolutionStep> steps; //the path so far
+			static inline thread_local std::deque<ChordNode> nodes; //every node of the tree, so they are freed together
+			static inline thread_local const FragmentIndex* fragments = nullptr; //fragments to try before single moves, if any
+			static inline thread_local const KeySpan* span = nullptr; //span whose live states prune the tree, if any
+			static inline thread_local std::stop_token stop; //gives up on the tree once requested
+
+			//the last bass note of the path
+			static Note writtenBass(const Key& key);
 
 			bool explored = false;
 			bool generatedDestinations = false;
+			size_t triedFragments = 0; //# of fragment moves that were taken from this node
 
 			std::vector<ChordNode*> destinations;
 
 			ChordNode* previous = nullptr; //node that was visited before this node
 			ChordNode* next     = nullptr;
 
-			std::optional<int> legalBassPitch(Key& key, const Chord& destination);
+			std::optional<int> legalBassPitch(const Key& key, const Chord& destination);
 			bool validInversion();
-			std::vector<ChordNode*> generateDestinations(Key* key);
+			void generateDestinations(const Key* key);
 
 			inline void printData() {
-				for (Note& note : m_chord->notes) {
+				for (const Note& note : m_chord->notes) {
 					std::cout << note.name << " ";
 				}
 				std::cout << std::endl;
@@ -50,15 +111,117 @@ namespace msc {
 		ChordNode* m_cursor   = nullptr;
 		ChordNode* m_current  = nullptr;
 		
-		Key* m_key = nullptr;
+		const Key* m_key = nullptr;
 
-		void explore();
+		EndCondition m_endCondition;
+
+		/*follows the next untried fragment out of the cursor, moving the cursor to its end. 
+		Returns false if there are no fragments left to try*/
+		bool followFragment();
+
+		//returns false if every path has been explored without reaching the goal
+		bool explore();
 	public:
-		OutputData getPath();
+		//returns nothing if the tree has no path
+		std::optional<OutputData> getPath();
+
+		ChordTree(const Key* key, std::span<const Note> sopranoLine, Note firstBassNote, const Chord* chord, 
+			      size_t startSopranoNoteIdx, size_t chordCountGoal, EndCondition endCondition = {}, 
+			      const FragmentIndex* fragments = nullptr, const KeySpan* span = nullptr, std::stop_token stop = {});
+	};
+
+	/*groups soprano notes into slots of slotLength, each represented by the first note of the slot. 
+	Notes that start before startTime are kept as they are*/
+	std::vector<Note> collapseHarmonicRhythm(std::span<const Note> sopranoLine, int slotLength, int startTime);
+
+	//a chord and the bass note under it
+	struct BassState {
+		Chord chord;
+		Note bass;
+	};
+
+	inline constexpr size_t BASS_PITCH_COUNT = HIGHEST_BASS_PITCH - LOWEST_BASS_PITCH + 1;
+	inline constexpr size_t MAX_BASS_STATES = ChordSet{}.size() * MAX_CHORD_TONES * BASS_PITCH_COUNT;
+
+	//a set of chords of a key, in each of their inversions, with an in range bass note
+	using StateSet = std::bitset<MAX_BASS_STATES>;
+
+	inline size_t stateIndex(const Chord& chord, int pitch) {
+		return (static_cast<size_t>(chord.id) * MAX_CHORD_TONES + static_cast<size_t>(chord.inversion)) * BASS_PITCH_COUNT + 
+			   static_cast<size_t>(pitch - LOWEST_BASS_PITCH);
+	}
+
+	//a stretch of the soprano that is harmonized in one key
+	struct KeySpan {
+		const Key* key = nullptr;
+		size_t startIdx = 0; //index of the note before the span, whose chord is already written
+		size_t endIdx = 0;   //index of the last note of the span
+		const Key* nextKey = nullptr; //key the last chord of the span has to pivot into
+		std::optional<HarmonyLabel> waypoint; //chord the last note of the span is labeled with, if any
+
+		//the states of the notes startIdx..endIdx that have a path to the end of the bassline, if they were worked out (see findLiveStates)
+		std::shared_ptr<const std::vector<StateSet>> liveStates;
+
+		//false if the state at noteIdx is known to have no path to the end of the bassline
+		inline bool isLive(size_t noteIdx, const Chord& chord, int pitch) const {
+			return liveStates == nullptr || (*liveStates)[noteIdx - startIdx].test(stateIndex(chord, pitch));
+		}
+	};
+
+	//whether a span can end on chord over a bass of pitch. It has to match the waypoint and pin, and pivot into the next key
+	bool acceptsSpanEnd(const KeySpan& span, const std::optional<BassState>& pin, const Chord& chord, int pitch);
+
+	inline constexpr int MAX_SPAN_ATTEMPTS = 4; //# of times a group of key spans is searched before giving up
+
+	//how the spans of a bassline are searched
+	struct SearchOptions {
+		size_t threads = 1; //with more than 1, each span is searched by that many threads (see solveSpanParallel)
+		const FragmentIndex* fragments = nullptr; //known fragments that are tried before single moves, if any
+		std::chrono::milliseconds refineTime{ 0 }; //time spent smoothing the written bassline (see BassLineRefiner)
+		std::stop_token stop; //the search gives up, finding nothing, once a stop is requested
+	};
 
-		ChordTree(Key* key, std::vector<Note>& sopranoLine, Note firstBassNote, Chord* chord, 
-			      size_t startSopranoNoteIdx, size_t chordCountGoal);
+	/*harmonizes one span, starting from the given chord. If endState is given, the span has to end on it. 
+	Fragments of the index are tried first wherever the soprano matches one. Gives up once stop is requested*/
+	std::optional<OutputData> solveSpan(const KeySpan& span, std::span<const Note> sopranoLine, const Note& startBass, 
+		                                const Chord& startChord, std::optional<BassState> endState = {}, 
+		                                const FragmentIndex* fragments = nullptr, std::stop_token stop = {});
+
+	/*harmonizes consecutive spans, carrying the last chord of each span into the next key as a pivot if it changes key.
+	pins[i] optionally fixes the state the i-th span ends on, which lets the spans after it be solved concurrently*/
+	std::optional<OutputData> solveKeySpans(const std::vector<KeySpan>& spans, std::span<const Note> sopranoLine, 
+		                                    const BassState& start, const std::vector<std::optional<BassState>>& pins, 
+		                                    const SearchOptions& options = {});
+
+	//the soprano line as it is harmonized, split into key spans, with the state the search starts from
+	struct BassLinePlan {
+		std::span<const Note> sopranoLine; //non-owning
+		std::optional<std::vector<Note>> collapsedLine; //the soprano collapsed into chord slots, if there is a harmonic rhythm
+		std::vector<KeySpan> spans; //empty if there is nothing to write. Spans end at key changes and waypoints
+		BassState start;
+		std::vector<std::optional<BassState>> pins; //see solveKeySpans
+
+		//the soprano, with one note per chord
+		inline std::span<const Note> harmonizedLine() const {
+			return collapsedLine.has_value() ? std::span<const Note>{ collapsedLine.value() } : sopranoLine;
+		}
 	};
 
-	OutputData writeBassLine(Key& key, std::vector<Note>& sopranoLine, std::vector<Note>& bassLine, int finalDegree);
+	/*splits the unwritten part of the soprano into spans at key changes and waypoints. Returns nothing if the spans 
+	can't be connected*/
+	std::optional<BassLinePlan> planBassLine(const std::vector<KeySegment>& keys, std::span<const Note> sopranoLine, 
+		                                     std::span<const Note> bassLine, int finalDegree, int harmonicRhythm = 0, 
+		                                     const std::vector<HarmonyLabel>& waypoints = {});
+
+	/*fixes the waypoints of the plan, harmonizes its spans and refines the result if the options ask for it. 
+	Returns nothing if there is no bassline that follows the rules*/
+	std::optional<OutputData> solvePlan(BassLinePlan& plan, const SearchOptions& options = {});
+
+	/*keys holds the key of each segment of the soprano. harmonicRhythm is the length of a chord slot. 
+	If it is 0, every soprano note gets its own chord. waypoints are chord labels at soprano indices; the chord under 
+	each labeled note is fixed, along with its inversion if the label has one. The spans between waypoints are solved 
+	concurrently. Returns nothing if there is no bassline that follows the rules*/
+	std::optional<OutputData> writeBassLine(const std::vector<KeySegment>& keys, std::span<const Note> sopranoLine, 
+		                                    std::span<const Note> bassLine, int finalDegree, int harmonicRhythm = 0, 
+		                                    const std::vector<HarmonyLabel>& waypoints = {}, const SearchOptions& options = {});
 }
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+
+namespace msc {
+	inline constexpr int SECONDARY_DOM_DEGREE = -1;    //V/V
+	inline constexpr int SECONDARY_DOM_OF_SIX_DEGREE = -2;  //V/vi (V/VI in minor)
+	inline constexpr int SECONDARY_DOM_OF_FOUR_DEGREE = -3; //V7/IV (V7/iv in minor)
+	inline constexpr int DIMINISHED_SEVENTH_DEGREE = -4; //vii°7
+	inline constexpr int NEAPOLITAN_DEGREE = -5;        //bII
+	inline constexpr int ITALIAN_SIXTH_DEGREE = -6;
+	inline constexpr int FRENCH_SIXTH_DEGREE = -7;
+	inline constexpr int GERMAN_SIXTH_DEGREE = -8;
+
+	inline constexpr size_t MAX_CHORD_TONES = 4;
+	inline constexpr size_t MAX_CHORD_DESTINATIONS = 10;
+
+	//a chord tone, as the # of letters and halfsteps it lies above the tonic
+	struct ChordTone {
+		int letterSteps = 0;
+		int halfSteps = 0;
+	};
+
+	/*A chord of a key and the degrees of the chords it may move to. Tones are listed from the root up,
+	so the index of a tone is the inversion that puts it in the bass. Unused destinations are 0.*/
+	struct ChordSpec {
+		int degree = 0;
+		size_t toneCount = 0;
+		std::array<ChordTone, MAX_CHORD_TONES> tones{};
+		std::array<int, MAX_CHORD_DESTINATIONS> destinations{};
+	};
+
+	//iii has no way in, so it never gets picked, and ii and V always carry their sevenths
+	inline constexpr std::array<ChordSpec, 15> majorVocabulary{ {
+		{ 1, 3, { { { 0, 0 }, { 2, 4 }, { 4, 7 } } },
+		  { 4, 5, 6, 7, SECONDARY_DOM_DEGREE, SECONDARY_DOM_OF_SIX_DEGREE, SECONDARY_DOM_OF_FOUR_DEGREE,
+		    DIMINISHED_SEVENTH_DEGREE, NEAPOLITAN_DEGREE } },
+		{ 2, 4, { { { 1, 2 }, { 3, 5 }, { 5, 9 }, { 0, 0 } } }, { 5, 7, DIMINISHED_SEVENTH_DEGREE } },
+		{ 3, 3, { { { 2, 4 }, { 4, 7 }, { 6, 11 } } }, {} },
+		{ 4, 3, { { { 3, 5 }, { 5, 9 }, { 0, 0 } } },
+		  { 1, 2, 5, SECONDARY_DOM_DEGREE, ITALIAN_SIXTH_DEGREE, FRENCH_SIXTH_DEGREE, GERMAN_SIXTH_DEGREE } },
+		{ 5, 4, { { { 4, 7 }, { 6, 11 }, { 1, 2 }, { 3, 5 } } }, { 1, 6, SECONDARY_DOM_DEGREE } },
+		{ 6, 3, { { { 5, 9 }, { 0, 0 }, { 2, 4 } } },
+		  { 2, 4, 5, NEAPOLITAN_DEGREE, ITALIAN_SIXTH_DEGREE, FRENCH_SIXTH_DEGREE, GERMAN_SIXTH_DEGREE } },
+		{ 7, 3, { { { 6, 11 }, { 1, 2 }, { 3, 5 } } }, { 1 } },
+		{ SECONDARY_DOM_DEGREE, 3, { { { 1, 2 }, { 3, 6 }, { 5, 9 } } }, { 5, 6 } },
+		{ SECONDARY_DOM_OF_SIX_DEGREE, 3, { { { 2, 4 }, { 4, 8 }, { 6, 11 } } }, { 6 } },
+		{ SECONDARY_DOM_OF_FOUR_DEGREE, 4, { { { 0, 0 }, { 2, 4 }, { 4, 7 }, { 6, 10 } } }, { 4 } },
+		{ DIMINISHED_SEVENTH_DEGREE, 4, { { { 6, 11 }, { 1, 2 }, { 3, 5 }, { 5, 8 } } }, { 1 } },
+		{ NEAPOLITAN_DEGREE, 3, { { { 1, 1 }, { 3, 5 }, { 5, 8 } } }, { 5, DIMINISHED_SEVENTH_DEGREE } },
+		{ ITALIAN_SIXTH_DEGREE, 3, { { { 5, 8 }, { 0, 0 }, { 3, 6 } } }, { 5 } },
+		{ FRENCH_SIXTH_DEGREE, 4, { { { 5, 8 }, { 0, 0 }, { 1, 2 }, { 3, 6 } } }, { 5 } },
+		{ GERMAN_SIXTH_DEGREE, 4, { { { 5, 8 }, { 0, 0 }, { 2, 3 }, { 3, 6 } } }, { 5 } }
+	} };
+
+	//the same progressions as in major, with chords built on the harmonic minor scale
+	inline constexpr std::array<ChordSpec, 15> harmonicMinorVocabulary{ {
+		{ 1, 3, { { { 0, 0 }, { 2, 3 }, { 4, 7 } } },
+		  { 4, 5, 6, 7, SECONDARY_DOM_DEGREE, SECONDARY_DOM_OF_SIX_DEGREE, SECONDARY_DOM_OF_FOUR_DEGREE,
+		    DIMINISHED_SEVENTH_DEGREE, NEAPOLITAN_DEGREE } },
+		{ 2, 4, { { { 1, 2 }, { 3, 5 }, { 5, 8 }, { 0, 0 } } }, { 5, 7, DIMINISHED_SEVENTH_DEGREE } },
+		{ 3, 3, { { { 2, 3 }, { 4, 7 }, { 6, 11 } } }, {} },
+		{ 4, 3, { { { 3, 5 }, { 5, 8 }, { 0, 0 } } },
+		  { 1, 2, 5, SECONDARY_DOM_DEGREE, ITALIAN_SIXTH_DEGREE, FRENCH_SIXTH_DEGREE, GERMAN_SIXTH_DEGREE } },
+		{ 5, 4, { { { 4, 7 }, { 6, 11 }, { 1, 2 }, { 3, 5 } } }, { 1, 6, SECONDARY_DOM_DEGREE } },
+		{ 6, 3, { { { 5, 8 }, { 0, 0 }, { 2, 3 } } },
+		  { 2, 4, 5, NEAPOLITAN_DEGREE, ITALIAN_SIXTH_DEGREE, FRENCH_SIXTH_DEGREE, GERMAN_SIXTH_DEGREE } },
+		{ 7, 3, { { { 6, 11 }, { 1, 2 }, { 3, 5 } } }, { 1 } },
+		{ SECONDARY_DOM_DEGREE, 3, { { { 1, 2 }, { 3, 6 }, { 5, 9 } } }, { 5, 6 } },
+		{ SECONDARY_DOM_OF_SIX_DEGREE, 3, { { { 2, 3 }, { 4, 7 }, { 6, 10 } } }, { 6 } },
+		{ SECONDARY_DOM_OF_FOUR_DEGREE, 4, { { { 0, 0 }, { 2, 4 }, { 4, 7 }, { 6, 10 } } }, { 4 } },
+		{ DIMINISHED_SEVENTH_DEGREE, 4, { { { 6, 11 }, { 1, 2 }, { 3, 5 }, { 5, 8 } } }, { 1 } },
+		{ NEAPOLITAN_DEGREE, 3, { { { 1, 1 }, { 3, 5 }, { 5, 8 } } }, { 5, DIMINISHED_SEVENTH_DEGREE } },
+		{ ITALIAN_SIXTH_DEGREE, 3, { { { 5, 8 }, { 0, 0 }, { 3, 6 } } }, { 5 } },
+		{ FRENCH_SIXTH_DEGREE, 4, { { { 5, 8 }, { 0, 0 }, { 1, 2 }, { 3, 6 } } }, { 5 } },
+		{ GERMAN_SIXTH_DEGREE, 4, { { { 5, 8 }, { 0, 0 }, { 2, 3 }, { 3, 6 } } }, { 5 } }
+	} };
+}
@@ -1,5 +1,18 @@
 #include "file_util.h"
 
+#include <cctype>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 //move iterator until its value contains the substring A or B, or reaches the end
 void msc::skipToEitherLine(StringVecIt& it, StringVecIt endIt, std::string substrA, std::string substrB) {
 	while (it != endIt && !it->contains(substrA) && !it->contains(substrB)) {
@@ -7,6 +20,13 @@ void msc::skipToEitherLine(StringVecIt& it, StringVecIt endIt, std::string subst
 	}
 }
 
+//move iterator until its value contains any of the substrings, or reaches the end
+void msc::skipToAnyLine(StringVecIt& it, StringVecIt endIt, const std::vector<std::string>& substrs) {
+	while (it != endIt && std::none_of(substrs.begin(), substrs.end(), [&it](const std::string& substr) { return it->contains(substr); })) {
+		it++;
+	}
+}
+
 //move iterator until its value contains the substring substr without bounds checking
 void msc::skipToLine(StringVecIt& it, StringVecIt endIt, std::string substr, int decrement) {
 	while (it != endIt && !it->contains(substr)) {
@@ -14,6 +34,11 @@ void msc::skipToLine(StringVecIt& it, StringVecIt endIt, std::string substr, int
 	}
 };
 
+std::string msc::withoutWhitespace(std::string str) {
+	str.erase(std::remove_if(str.begin(), str.end(), [](unsigned char chr) { return std::isspace(chr); }), str.end());
+	return str;
+}
+
 //returns the enclosed substring sandwiched between two of the given characters
 std::string msc::enclosedString(std::string str, char chrLeft, char chrRight) {
 	std::string ret;
@@ -26,4 +51,59 @@ std::string msc::enclosedString(std::string str, char chrLeft, char chrRight) {
 
 std::string msc::makeAttribute(std::string attributeName, std::string bracketedString) {
 	return std::string("<") + attributeName + ">" + bracketedString + "</" + attributeName + ">";
-}
\ No newline at end of file
+}
+
+#ifdef _WIN32
+msc::MappedFile::MappedFile(const std::string& path) {
+	m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE) {
+		m_file = nullptr;
+		return;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0) {
+		return;
+	}
+	m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping == nullptr) {
+		return;
+	}
+	m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	m_size = m_data != nullptr ? static_cast<size_t>(size.QuadPart) : 0;
+}
+
+msc::MappedFile::~MappedFile() {
+	if (m_data != nullptr) {
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mapping != nullptr) {
+		CloseHandle(m_mapping);
+	}
+	if (m_file != nullptr) {
+		CloseHandle(m_file);
+	}
+}
+#else
+msc::MappedFile::MappedFile(const std::string& path) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return;
+	}
+	struct stat info;
+	if (fstat(fd, &info) == 0 && info.st_size > 0) {
+		void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) {
+			m_data = static_cast<const uint8_t*>(data);
+			m_size = static_cast<size_t>(info.st_size);
+			madvise(data, m_size, MADV_SEQUENTIAL); //the file is read front to back once
+		}
+	}
+	close(fd); //the mapping stays valid without the descriptor
+}
+
+msc::MappedFile::~MappedFile() {
+	if (m_data != nullptr) {
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+	}
+}
+#endif
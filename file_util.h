@@ -3,6 +3,9 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <span>
+#include <cstdint>
+#include <cstddef>
 
 namespace msc {
 	using StringVecIt = std::vector<std::string>::iterator;
@@ -11,11 +14,42 @@ namespace msc {
 	//move iterator until its value contains the substring A or B, or reaches the end
 	void skipToEitherLine(StringVecIt& it, StringVecIt endIt, std::string substrA, std::string substrB);
 
+	//move iterator until its value contains any of the substrings, or reaches the end
+	void skipToAnyLine(StringVecIt& it, StringVecIt endIt, const std::vector<std::string>& substrs);
+
 	//move iterator until its value contains the substring substr without bounds checking
 	void skipToLine(StringVecIt& it, StringVecIt endIt, std::string substr, int decerement);
 
+	//removes every whitespace character from the string, so tags can be matched however they were indented or spaced
+	std::string withoutWhitespace(std::string str);
+
 	//returns the enclosed substring sandwiched between two of the given characters
 	std::string enclosedString(std::string str, char chrLeft, char chrRight);
 
 	std::string makeAttribute(std::string attributeName, std::string bracketedString);
+
+	//a read only file mapped into memory, so that it can be read without copying it into a buffer first
+	class MappedFile {
+	private:
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+#ifdef _WIN32
+		void* m_file = nullptr;
+		void* m_mapping = nullptr;
+#endif
+	public:
+		explicit MappedFile(const std::string& path);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		//false if the file couldn't be opened or is empty
+		inline bool isOpen() const {
+			return m_data != nullptr;
+		}
+		inline std::span<const uint8_t> bytes() const {
+			return { m_data, m_size };
+		}
+	};
 }
\ No newline at end of file
@@ -0,0 +1,215 @@
+#include "fragment_index.h"
+
+#include <fstream>
+#include <cstring>
+#include <ranges>
+
+static_assert(12 + 12 * msc::FRAGMENT_LENGTH <= 64, "fragment contexts have to fit in 64 bits");
+
+uint64_t msc::fragmentContext(const Key& key, const Chord& entryChord, std::span<const Note> sopranoLine, size_t noteIdx) {
+	int tonic = pitchClass(key.tonic());
+	auto relativePitchClass = [tonic](const Note& note) {
+		return static_cast<uint64_t>((pitchClass(note) - tonic + 12) % 12);
+	};
+
+	//1 bit of mode, 5 of chord id, 2 of inversion and 4 of soprano pitch class, then 12 bits for each note of the fragment
+	uint64_t context = (key.major ? 1 : 0) | static_cast<uint64_t>(entryChord.id & 0x1F) << 1 | 
+		               static_cast<uint64_t>(entryChord.inversion & 0x3) << 6 | relativePitchClass(sopranoLine[noteIdx]) << 8;
+	for (size_t i = 1; i <= FRAGMENT_LENGTH; i++) {
+		int interval = std::clamp(sopranoLine[noteIdx + i].pitch - sopranoLine[noteIdx + i - 1].pitch, -127, 127);
+		uint64_t note = relativePitchClass(sopranoLine[noteIdx + i]) | static_cast<uint64_t>(static_cast<uint8_t>(interval)) << 4;
+		context |= note << (12 * i);
+	}
+	return context;
+}
+
+msc::FragmentIndex::FragmentIndex(const std::string& path) : m_file(path) {
+	if (!m_file.isOpen()) {
+		std::cout << "Error: couldn't open the fragment index " << path << std::endl;
+		return;
+	}
+
+	std::span<const uint8_t> bytes = m_file.bytes();
+	FragmentIndexHeader header;
+	if (bytes.size() < sizeof(header)) {
+		std::cout << "Error: " << path << " is not a fragment index\n";
+		return;
+	}
+	std::memcpy(&header, bytes.data(), sizeof(header));
+	if (header.magic != FRAGMENT_INDEX_MAGIC || header.version != FRAGMENT_INDEX_VERSION || header.fragmentLength != FRAGMENT_LENGTH || 
+		bytes.size() < sizeof(header) + header.recordCount * sizeof(FragmentRecord)) 
+	{
+		std::cout << "Error: " << path << " is not a fragment index of this version\n";
+		return;
+	}
+
+	//the records are read in place. The header keeps them 8 byte aligned from the page aligned mapping
+	m_records = { reinterpret_cast<const FragmentRecord*>(bytes.data() + sizeof(header)), header.recordCount };
+}
+
+std::span<const msc::FragmentRecord> msc::FragmentIndex::lookup(uint64_t context) const {
+	auto matches = std::ranges::equal_range(m_records, context, {}, &FragmentRecord::context);
+	return { matches.begin(), matches.end() };
+}
+
+std::vector<std::vector<msc::SolutionStep>> msc::FragmentIndex::moves(const Key& key, std::span<const Note> sopranoLine, size_t noteIdx, 
+	                                                                  const Chord& chord, const Note& bass, size_t goalIdx, 
+	                                                                  const EndCondition& endCondition) const
+{
+	std::vector<std::vector<SolutionStep>> ret;
+	if (noteIdx + FRAGMENT_LENGTH > goalIdx || noteIdx + FRAGMENT_LENGTH >= sopranoLine.size()) {
+		return ret;
+	}
+
+	//fragments come from other scores, so every move is checked against the rules like a move of the search
+	for (const FragmentRecord& record : lookup(fragmentContext(key, chord, sopranoLine, noteIdx))) {
+		std::vector<SolutionStep> steps;
+		const Chord* previousChord = &chord;
+		Note previousBass = bass;
+
+		for (size_t i = 0; i < FRAGMENT_LENGTH; i++) {
+			size_t idx = noteIdx + i + 1;
+			const Note& soprano = sopranoLine[idx];
+			const Note& previousSoprano = sopranoLine[idx - 1];
+			if (record.chordIds[i] >= key.chordCount() || record.inversions[i] >= key.chordOfId(record.chordIds[i]).notes.size() || 
+				!key.candidates(*previousChord, soprano).test(record.chordIds[i])) 
+			{
+				break;
+			}
+
+			const Chord& next = key.chordOfId(record.chordIds[i], record.inversions[i]);
+			Note nextBass = next.notes[record.inversions[i]];
+			int pitch = previousBass.pitch + record.bassSteps[i];
+			if ((pitch - nextBass.pitch) % 12 != 0) { //the bass has to be the chord tone of the inversion
+				break;
+			}
+			nextBass.pitch = pitch;
+			nextBass.duration = soprano.duration;
+
+			if (inversionViolation(next, previousChord->degree, idx == sopranoLine.size() - 1) || 
+				bassNameViolation(key, previousBass, previousSoprano, nextBass, soprano) || 
+				bassPitchViolation(key, *previousChord, previousBass, soprano.pitch - previousSoprano.pitch, nextBass) || 
+				(idx == goalIdx && endCondition && !endCondition(next, pitch))) 
+			{
+				break;
+			}
+
+			steps.emplace_back(record.chordIds[i], record.inversions[i], static_cast<uint8_t>(pitch), 0, soprano.duration);
+			previousChord = &next;
+			previousBass = nextBass;
+		}
+
+		if (steps.size() == FRAGMENT_LENGTH) {
+			ret.push_back(std::move(steps));
+		}
+		if (ret.size() == MAX_FRAGMENT_MOVES) {
+			break;
+		}
+	}
+
+	return ret;
+}
+
+std::vector<msc::FragmentRecord> msc::collectFragments(const ScoreData& score) {
+	std::vector<FragmentRecord> records;
+	if (score.keys.empty()) {
+		return records;
+	}
+
+	//the bass note that starts with each soprano note, if any
+	std::vector<std::optional<size_t>> bassIndices(score.soprano.size());
+	int sopranoOnset = 0;
+	int bassOnset = 0;
+	for (size_t sopranoIdx = 0, bassIdx = 0; sopranoIdx < score.soprano.size() && bassIdx < score.bass.size(); sopranoIdx++) {
+		while (bassIdx < score.bass.size() && bassOnset < sopranoOnset) {
+			bassOnset += score.bass[bassIdx++].duration;
+		}
+		if (bassIdx < score.bass.size() && bassOnset == sopranoOnset) {
+			bassIndices[sopranoIdx] = bassIdx;
+		}
+		sopranoOnset += score.soprano[sopranoIdx].duration;
+	}
+
+	//the chord under each soprano note, from the labels of the bass part
+	std::vector<const Chord*> chords(score.soprano.size(), nullptr);
+	std::vector<const Key*> keys(score.soprano.size(), nullptr);
+	for (size_t noteIdx = 0; noteIdx < score.soprano.size(); noteIdx++) {
+		auto labelIt = std::ranges::find(score.harmonies, bassIndices[noteIdx], [](const HarmonyLabel& label) { 
+			return std::optional<size_t>{ label.noteIdx }; 
+		});
+		if (!bassIndices[noteIdx].has_value() || labelIt == score.harmonies.end()) {
+			continue;
+		}
+		auto segmentIt = std::ranges::find_if(score.keys | std::views::reverse, [noteIdx](const KeySegment& segment) {
+			return segment.noteIdx <= noteIdx;
+		});
+		const Key& key = segmentIt == score.keys.rend() ? *score.keys.front().key : *segmentIt->key;
+		const Chord* chord = key.chordOfDegree(labelIt->degree);
+		if (chord == nullptr) {
+			continue;
+		}
+		int inversion = labelIt->inversion.value_or(getInversion(chord->notes, score.bass[labelIt->noteIdx]));
+		if (inversion >= static_cast<int>(chord->notes.size())) {
+			continue;
+		}
+		chords[noteIdx] = &key.chordOfId(static_cast<size_t>(chord->id), inversion);
+		keys[noteIdx] = &key;
+	}
+
+	//every run of labeled notes in one key, after a labeled note, is a fragment
+	for (size_t noteIdx = 0; noteIdx + FRAGMENT_LENGTH < score.soprano.size(); noteIdx++) {
+		FragmentRecord record;
+		bool complete = true;
+		for (size_t i = 0; i <= FRAGMENT_LENGTH && complete; i++) {
+			complete = chords[noteIdx + i] != nullptr && keys[noteIdx + i] == keys[noteIdx];
+		}
+		if (!complete) {
+			continue;
+		}
+
+		record.context = fragmentContext(*keys[noteIdx], *chords[noteIdx], score.soprano, noteIdx);
+		record.count = 1;
+		for (size_t i = 0; i < FRAGMENT_LENGTH; i++) {
+			const Chord& chord = *chords[noteIdx + i + 1];
+			int bassStep = score.bass[bassIndices[noteIdx + i + 1].value()].pitch - score.bass[bassIndices[noteIdx + i].value()].pitch;
+			record.chordIds[i] = static_cast<uint8_t>(chord.id);
+			record.inversions[i] = static_cast<uint8_t>(chord.inversion);
+			record.bassSteps[i] = static_cast<int8_t>(std::clamp(bassStep, -127, 127));
+		}
+		records.push_back(record);
+	}
+
+	return records;
+}
+
+bool msc::writeFragmentIndex(const std::string& path, std::vector<FragmentRecord> records) {
+	//equal fragments are merged, keeping count of how often they were seen
+	auto sameMoves = [](const FragmentRecord& a, const FragmentRecord& b) {
+		return std::tie(a.context, a.chordIds, a.inversions, a.bassSteps) == std::tie(b.context, b.chordIds, b.inversions, b.bassSteps);
+	};
+	std::ranges::sort(records, [](const FragmentRecord& a, const FragmentRecord& b) {
+		return std::tie(a.context, a.chordIds, a.inversions, a.bassSteps) < std::tie(b.context, b.chordIds, b.inversions, b.bassSteps);
+	});
+	std::vector<FragmentRecord> merged;
+	for (const FragmentRecord& record : records) {
+		if (!merged.empty() && sameMoves(merged.back(), record)) {
+			merged.back().count += record.count;
+		} else {
+			merged.push_back(record);
+		}
+	}
+	std::ranges::stable_sort(merged, [](const FragmentRecord& a, const FragmentRecord& b) {
+		return a.context != b.context ? a.context < b.context : a.count > b.count;
+	});
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		std::cout << "Error: couldn't write the fragment index " << path << std::endl;
+		return false;
+	}
+	FragmentIndexHeader header;
+	header.recordCount = static_cast<uint32_t>(merged.size());
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(merged.data()), static_cast<std::streamsize>(merged.size() * sizeof(FragmentRecord)));
+	return static_cast<bool>(file);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <span>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "bassline_maker.h"
+#include "parser.h"
+
+namespace msc {
+	inline constexpr size_t FRAGMENT_LENGTH = 4;    //# of chords in a fragment
+	inline constexpr size_t MAX_FRAGMENT_MOVES = 4; //# of fragments a search tries at a node before going note by note
+	inline constexpr uint32_t FRAGMENT_INDEX_MAGIC = 0x4643534D; //"MSCF"
+	inline constexpr uint32_t FRAGMENT_INDEX_VERSION = 1;
+
+	/*chords and bass notes that followed a soprano figure in a solved score. The figure is kept as pitch classes 
+	above the tonic and intervals, so the fragment can be tried in every key of the same mode. Records are 
+	written to the index file as they are, so the layout is part of the file format*/
+	struct FragmentRecord {
+		uint64_t context = 0; //mode, entry chord and soprano figure, see fragmentContext
+		uint32_t count = 0;   //# of times the fragment was seen
+		std::array<uint8_t, FRAGMENT_LENGTH> chordIds{};
+		std::array<uint8_t, FRAGMENT_LENGTH> inversions{};
+		std::array<int8_t, FRAGMENT_LENGTH> bassSteps{}; //halfsteps from the previous bass note
+	};
+	static_assert(sizeof(FragmentRecord) == 24, "FragmentRecord is stored in index files as it is");
+
+	//start of an index file, followed by recordCount records sorted by context, the most seen first
+	struct FragmentIndexHeader {
+		uint32_t magic = FRAGMENT_INDEX_MAGIC;
+		uint32_t version = FRAGMENT_INDEX_VERSION;
+		uint32_t fragmentLength = FRAGMENT_LENGTH;
+		uint32_t recordCount = 0;
+	};
+
+	/*packs the lookup key of the fragments that start after the note at noteIdx: the mode of the key, the 
+	chord on that note and the next FRAGMENT_LENGTH soprano notes. noteIdx + FRAGMENT_LENGTH must be in sopranoLine*/
+	uint64_t fragmentContext(const Key& key, const Chord& entryChord, std::span<const Note> sopranoLine, size_t noteIdx);
+
+	//a fragment index file, mapped into memory and searched where it lies
+	class FragmentIndex {
+	private:
+		MappedFile m_file;
+		std::span<const FragmentRecord> m_records;
+	public:
+		explicit FragmentIndex(const std::string& path);
+
+		//false if the file couldn't be read or isn't an index of this version
+		inline bool isOpen() const {
+			return !m_records.empty();
+		}
+		inline size_t size() const {
+			return m_records.size();
+		}
+
+		//the fragments with the given context, the most seen first
+		std::span<const FragmentRecord> lookup(uint64_t context) const;
+
+		/*the fragments that can follow chord and bass at noteIdx without breaking a rule, as steps of key, the 
+		most seen first. Fragments that would run past goalIdx are left out, and the ones that end on it have to 
+		satisfy endCondition, if there is one*/
+		std::vector<std::vector<SolutionStep>> moves(const Key& key, std::span<const Note> sopranoLine, size_t noteIdx, const Chord& chord, 
+			                                         const Note& bass, size_t goalIdx, const EndCondition& endCondition = {}) const;
+	};
+
+	//the fragments of a score whose bass notes are labeled, like the scores this program writes. Only notes with a bass note under them count
+	std::vector<FragmentRecord> collectFragments(const ScoreData& score);
+
+	//merges equal fragments and writes them as an index. Returns false if the file couldn't be written
+	bool writeFragmentIndex(const std::string& path, std::vector<FragmentRecord> records);
+}
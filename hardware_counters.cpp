@@ -0,0 +1,127 @@
+#include "hardware_counters.h"
+
+#include <atomic>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+	std::atomic<uint32_t> openedCounters = 0;
+
+#ifdef __linux__
+	struct CounterConfig {
+		uint32_t type;
+		uint64_t config;
+	};
+
+	constexpr uint64_t cacheReadMisses(uint64_t cache) {
+		return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	}
+
+	//in the order of HardwareCounter. Cycles lead the group, so the others are scheduled together with them
+	constexpr std::array<CounterConfig, msc::HARDWARE_COUNTER_COUNT> counterConfigs{ {
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+		{ PERF_TYPE_HW_CACHE, cacheReadMisses(PERF_COUNT_HW_CACHE_L1D) },
+		{ PERF_TYPE_HW_CACHE, cacheReadMisses(PERF_COUNT_HW_CACHE_LL) }
+	} };
+
+	//a group of counters of one thread, read with a single read call
+	class CounterGroup {
+	private:
+		std::array<int, msc::HARDWARE_COUNTER_COUNT> m_fds;
+		std::array<int, msc::HARDWARE_COUNTER_COUNT> m_slots; //position of each counter in a group read, or -1
+		int m_memberCount = 0;
+	public:
+		CounterGroup() {
+			m_fds.fill(-1);
+			m_slots.fill(-1);
+
+			uint32_t opened = 0;
+			for (size_t i = 0; i < counterConfigs.size(); i++) {
+				perf_event_attr attr{};
+				attr.size = sizeof(attr);
+				attr.type = counterConfigs[i].type;
+				attr.config = counterConfigs[i].config;
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				attr.read_format = PERF_FORMAT_GROUP;
+
+				long fd = syscall(SYS_perf_event_open, &attr, 0, -1, m_fds[0], 0); //this thread, on any CPU
+				if (fd < 0) {
+					if (i == 0) { //without the leader there is no group
+						return;
+					}
+					continue;
+				}
+				m_fds[i] = static_cast<int>(fd);
+				m_slots[i] = m_memberCount++;
+				opened |= 1u << i;
+			}
+			openedCounters.fetch_or(opened, std::memory_order_relaxed);
+		}
+		~CounterGroup() {
+			for (int fd : m_fds) {
+				if (fd >= 0) {
+					close(fd);
+				}
+			}
+		}
+
+		CounterGroup(const CounterGroup&) = delete;
+		CounterGroup& operator=(const CounterGroup&) = delete;
+
+		std::optional<msc::CounterValues> read() const {
+			if (m_fds[0] < 0) {
+				return {};
+			}
+
+			//a group read is the # of members followed by their values
+			std::array<uint64_t, msc::HARDWARE_COUNTER_COUNT + 1> buffer{};
+			if (::read(m_fds[0], buffer.data(), sizeof(buffer)) < static_cast<ssize_t>(sizeof(uint64_t) * (m_memberCount + 1))) {
+				return {};
+			}
+			msc::CounterValues values{};
+			for (size_t i = 0; i < values.size(); i++) {
+				if (m_slots[i] >= 0) {
+					values[i] = buffer[static_cast<size_t>(m_slots[i]) + 1];
+				}
+			}
+			return values;
+		}
+	};
+#endif
+}
+
+std::string_view msc::counterName(HardwareCounter counter) {
+	switch (counter) {
+	case HardwareCounter::CYCLES:
+		return "cycles";
+	case HardwareCounter::INSTRUCTIONS:
+		return "instructions";
+	case HardwareCounter::BRANCH_MISSES:
+		return "branchMisses";
+	case HardwareCounter::L1D_MISSES:
+		return "l1dMisses";
+	case HardwareCounter::LLC_MISSES:
+		return "llcMisses";
+	}
+	return "";
+}
+
+std::optional<msc::CounterValues> msc::readThreadCounters() {
+#ifdef __linux__
+	thread_local CounterGroup group;
+	return group.read();
+#else
+	return {};
+#endif
+}
+
+uint32_t msc::availableCounters() {
+	return openedCounters.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+namespace msc {
+	//the hardware events counted for each span of a trace
+	enum class HardwareCounter {
+		CYCLES,
+		INSTRUCTIONS,
+		BRANCH_MISSES,
+		L1D_MISSES, //reads that miss the level 1 data cache
+		LLC_MISSES  //reads that miss the last level cache
+	};
+	inline constexpr size_t HARDWARE_COUNTER_COUNT = 5;
+
+	using CounterValues = std::array<uint64_t, HARDWARE_COUNTER_COUNT>;
+
+	//name of a counter in the trace JSON
+	std::string_view counterName(HardwareCounter counter);
+
+	/*reads the hardware counters of the calling thread, which are opened with perf_event_open the first time 
+	the thread reads them. The counters run in user space only. Returns nothing if they can't be opened: off 
+	Linux, without a PMU (as in many VMs), or when perf_event_paranoid doesn't allow it. A counter that the CPU 
+	lacks while the others open reads as 0, see availableCounters*/
+	std::optional<CounterValues> readThreadCounters();
+
+	//bit i is set if counter i could be opened. 0 until some thread has read the counters
+	uint32_t availableCounters();
+}
@@ -0,0 +1,163 @@
+#include <cmath>
+
+#include "key_detection.h"
+#include "parser.h"
+#include "refinement.h"
+
+namespace {
+	//Krumhansl-Kessler probe tone ratings of each pitch class, from the tonic up
+	constexpr std::array<double, 12> majorProfile{ 6.35, 2.23, 3.48, 2.33, 4.38, 4.09, 2.52, 5.19, 2.39, 3.66, 2.29, 2.88 };
+	constexpr std::array<double, 12> minorProfile{ 6.33, 2.68, 3.52, 5.38, 2.60, 3.53, 2.54, 4.75, 3.98, 2.69, 3.34, 3.17 };
+
+	//names of the keys on each pitch class, spelled the way they usually are
+	const std::array<std::string, 12> majorKeyNames{ "C", "Db", "D", "Eb", "E", "F", "F#", "G", "Ab", "A", "Bb", "B" };
+	const std::array<std::string, 12> minorKeyNames{ "c", "c#", "d", "eb", "e", "f", "f#", "g", "g#", "a", "bb", "b" };
+
+	//pearson correlation of the histogram with the profile turned to start on tonic. 0 if either is flat
+	double correlation(const std::array<double, 12>& histogram, const std::array<double, 12>& profile, size_t tonic) {
+		double histogramMean = std::accumulate(histogram.begin(), histogram.end(), 0.0) / 12;
+		double profileMean = std::accumulate(profile.begin(), profile.end(), 0.0) / 12;
+
+		double covariance = 0, histogramVariance = 0, profileVariance = 0;
+		for (size_t pitchClass = 0; pitchClass < 12; pitchClass++) {
+			double x = histogram[pitchClass] - histogramMean;
+			double y = profile[(pitchClass + 12 - tonic) % 12] - profileMean;
+			covariance += x * y;
+			histogramVariance += x * x;
+			profileVariance += y * y;
+		}
+		if (histogramVariance == 0 || profileVariance == 0) {
+			return 0;
+		}
+		return covariance / std::sqrt(histogramVariance * profileVariance);
+	}
+}
+
+std::vector<msc::KeyHypothesis> msc::rankKeys(std::span<const Note> sopranoLine) {
+	std::array<double, 12> histogram{};
+	for (const Note& note : sopranoLine) {
+		histogram[static_cast<size_t>(pitchClass(note))] += std::max(note.duration, 1);
+	}
+
+	std::vector<KeyHypothesis> hypotheses;
+	for (size_t tonic = 0; tonic < 12; tonic++) {
+		hypotheses.emplace_back(keyFromName(majorKeyNames[tonic]), correlation(histogram, majorProfile, tonic));
+		hypotheses.emplace_back(keyFromName(minorKeyNames[tonic]), correlation(histogram, minorProfile, tonic));
+	}
+	std::ranges::stable_sort(hypotheses, std::ranges::greater{}, &KeyHypothesis::fit);
+	return hypotheses;
+}
+
+std::optional<msc::KeyedBassLine> msc::writeBassLineInAnyKey(std::span<const Note> sopranoLine, std::span<const Note> bassLine,
+	                                                          int finalDegree, int harmonicRhythm,
+	                                                          const std::vector<HarmonyLabel>& waypoints,
+	                                                          const SearchOptions& options)
+{
+	MSC_TRACE_SPAN("key hypotheses");
+
+	//the given bassline has to end on a tone of the final chord in the key
+	auto ranked = rankKeys(sopranoLine);
+	std::vector<KeyHypothesis> hypotheses;
+	for (const KeyHypothesis& hypothesis : ranked) {
+		if (hypotheses.size() == KEY_HYPOTHESES || hypothesis.fit < ranked.front().fit - MAX_FIT_GAP) {
+			break;
+		}
+		const Chord* finalChord = hypothesis.key->chordOfDegree(finalDegree);
+		bool endsOnFinalChord = finalChord != nullptr && (bassLine.empty() || std::ranges::any_of(finalChord->notes,
+			[&bassLine](const Note& note) { return pitchClass(note) == pitchClass(bassLine.back()); }));
+		if (endsOnFinalChord) {
+			hypotheses.push_back(hypothesis);
+		}
+	}
+	if (hypotheses.empty()) {
+		std::cout << "Error: the given bassline doesn't end on the final chord of any key the soprano fits\n";
+		return {};
+	}
+
+	//each key gets its own stop, so the ones that can't beat a solved key are stopped
+	std::vector<std::stop_source> stops(hypotheses.size());
+	std::stop_callback forwardStop{ options.stop, [&stops] {
+		for (std::stop_source& stop : stops) {
+			stop.request_stop();
+		}
+	} };
+
+	//the keys share the threads, and only the winner is refined
+	SearchOptions keyOptions = options;
+	keyOptions.threads = std::max<size_t>(options.threads / hypotheses.size(), 1);
+	keyOptions.refineTime = {};
+
+	std::mutex mutex;
+	std::vector<std::optional<BassLinePlan>> plans(hypotheses.size());
+	std::vector<std::optional<int>> floors(hypotheses.size()); //cheapest cost of each key, once it is worked out
+	std::optional<std::pair<int, size_t>> best; //cost and hypothesis of the cheapest solution so far
+
+	//a key is beaten once a solution costs less than anything it could write. Ties go to the better fitting key
+	auto beaten = [&](size_t hypothesisIdx) {
+		return best.has_value() && floors[hypothesisIdx].has_value() && 
+			   std::pair{ floors[hypothesisIdx].value(), hypothesisIdx } > best.value();
+	};
+	auto offer = [&](int cost, size_t hypothesisIdx) {
+		std::lock_guard lock{ mutex };
+		if (!best.has_value() || std::pair{ cost, hypothesisIdx } < best.value()) {
+			best = { cost, hypothesisIdx };
+			for (size_t i = 0; i < hypotheses.size(); i++) {
+				if (beaten(i)) {
+					stops[i].request_stop();
+				}
+			}
+		}
+	};
+
+	auto solveHypothesis = [&](size_t hypothesisIdx) -> std::optional<KeyedBassLine> {
+		const auto& key = hypotheses[hypothesisIdx].key;
+		auto& plan = plans[hypothesisIdx];
+		plan = planBassLine({ { 0, key } }, sopranoLine, bassLine, finalDegree, harmonicRhythm, waypoints);
+		if (!plan.has_value()) {
+			return {};
+		} else if (plan->spans.empty()) { //nothing is left to write
+			offer(0, hypothesisIdx);
+			return KeyedBassLine{ key, OutputData{}, 0 };
+		}
+
+		auto floor = cheapestCost(plan.value());
+		{
+			std::lock_guard lock{ mutex };
+			floors[hypothesisIdx] = floor;
+			if (!floor.has_value() || beaten(hypothesisIdx)) {
+				return {};
+			}
+		}
+
+		SearchOptions hypothesisOptions = keyOptions;
+		hypothesisOptions.stop = stops[hypothesisIdx].get_token();
+		auto solution = solvePlan(plan.value(), hypothesisOptions);
+		if (!solution.has_value()) {
+			return {};
+		}
+		int cost = bassLineCost(plan.value(), solution.value());
+		offer(cost, hypothesisIdx);
+		return KeyedBassLine{ key, std::move(solution.value()), cost };
+	};
+
+	std::vector<std::future<std::optional<KeyedBassLine>>> futures;
+	for (size_t i = 0; i < hypotheses.size(); i++) {
+		futures.push_back(std::async(std::launch::async, solveHypothesis, i));
+	}
+
+	std::vector<std::optional<KeyedBassLine>> results;
+	for (auto& future : futures) {
+		results.push_back(future.get());
+	}
+	if (!best.has_value() || !results[best->second].has_value()) {
+		return {};
+	}
+
+	size_t bestIdx = best->second;
+	KeyedBassLine& winner = results[bestIdx].value();
+	if (options.refineTime.count() > 0 && !plans[bestIdx]->spans.empty()) {
+		winner.solution = refineBassLine(plans[bestIdx].value(), winner.solution, options);
+		winner.cost = bassLineCost(plans[bestIdx].value(), winner.solution);
+	}
+	return std::move(winner);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "bassline_maker.h"
+
+namespace msc {
+	inline constexpr size_t KEY_HYPOTHESES = 4;      //# of the best fitting keys that are solved
+	inline constexpr double MAX_FIT_GAP = 0.3;       //keys that fit this much worse than the best one aren't solved
+
+	//a key the soprano could be in
+	struct KeyHypothesis {
+		std::shared_ptr<const Key> key;
+		double fit = 0; //correlation of the soprano's pitch classes with the profile of the key, from -1 to 1
+	};
+
+	/*ranks the 24 major and harmonic minor keys by how well the soprano's pitch class histogram,
+	weighted by duration, correlates with the Krumhansl-Kessler profile of each key. Best fit first*/
+	std::vector<KeyHypothesis> rankKeys(std::span<const Note> sopranoLine);
+
+	//a bassline, with the key it was written in
+	struct KeyedBassLine {
+		std::shared_ptr<const Key> key;
+		OutputData solution;
+		int cost = 0; //see bassLineCost
+	};
+
+	/*
+	* Writes a bassline for a soprano with no key annotation, like writeBassLine in a single key.
+	* The best fitting keys are solved concurrently, skipping ones that fit much worse than the best or
+	* whose final chord doesn't contain the last given bass note. Each key first works out the cheapest bassline
+	* it allows (see cheapestCost), and once a key is solved, the keys that can't write anything cheaper are stopped,
+	* so the whole thing takes about as long as the solves that could still win. The keys split options.threads 
+	* between them, and only the winner is refined. The cheapest bassline wins, and ties go to the better fitting key. 
+	* Returns nothing if no key was solved.
+	*/
+	std::optional<KeyedBassLine> writeBassLineInAnyKey(std::span<const Note> sopranoLine, std::span<const Note> bassLine,
+		                                               int finalDegree, int harmonicRhythm = 0,
+		                                               const std::vector<HarmonyLabel>& waypoints = {},
+		                                               const SearchOptions& options = {});
+}
@@ -1,19 +1,240 @@
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
 #include "parser.h"
 #include "bassline_maker.h"
 #include "output_writer.h"
+#include "validator.h"
+#include "midi_writer.h"
+#include "midi_reader.h"
+#include "streaming_solver.h"
+#include "solution_counter.h"
+#include "fragment_index.h"
+#include "key_detection.h"
 
-int main() {
+int main(int argc, char* argv[]) {
 	msc::ResultData info;
+	msc::PartSelection parts;
 	std::string fileName;
-	std::cout << "Enter the name of your musicxml score file: ";
-	std::cin >> fileName;
+	std::string harmonicRhythm; //"beat" or "half" to harmonize one chord per beat or half measure
+	bool validateOnly = false;  //check the labeled bassline of the score instead of writing one
+	bool stream = false;        //harmonize a live MIDI stream from stdin instead of a score
+	bool count = false;         //count the valid basslines of each score instead of writing one
+	bool buildIndex = false;    //collect the fragments of solved scores into the index file given first
+	std::vector<std::string> fileNames; //every score given, for counting in batch
+	size_t lookahead = msc::DEFAULT_LOOKAHEAD; //# of soprano notes a streamed bass note waits for
+	msc::SearchOptions searchOptions;
+	std::string fragmentsPath;  //fragment index the search tries first, if any
+	std::string tracePath;      //where to write a Chrome trace of the run, if anywhere
+	bool hardwareCounters = false; //read the hardware counters in each span of the trace
+	std::string midiPath;       //where to write the harmonized score as a MIDI file, if anywhere
+	msc::MidiOptions midiOptions; //key and final chord of MIDI scores that don't have them
+
+	/*optional arguments: [validate|stream|count|index] [score files] [--soprano <part id or name>] [--bass <part id or name>] 
+	[--harmonic-rhythm beat|half] [--trace <trace json file>] [--counters] [--midi <midi file>]
+	[--key <key name>] [--final <roman numeral>] [--lookahead <# of notes>] [--threads <# of threads>]
+	[--fragments <fragment index file>] [--refine <milliseconds>]*/
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--soprano" && i + 1 < argc) {
+			parts.soprano = argv[++i];
+		} else if (arg == "--bass" && i + 1 < argc) {
+			parts.bass = argv[++i];
+		} else if (arg == "--harmonic-rhythm" && i + 1 < argc) {
+			harmonicRhythm = argv[++i];
+		} else if (arg == "--trace" && i + 1 < argc) {
+			tracePath = argv[++i];
+		} else if (arg == "--counters") {
+			hardwareCounters = true;
+		} else if (arg == "--midi" && i + 1 < argc) {
+			midiPath = argv[++i];
+		} else if (arg == "--key" && i + 1 < argc) {
+			midiOptions.keyName = argv[++i];
+		} else if (arg == "--final" && i + 1 < argc && msc::numeralsToDegrees.contains(argv[i + 1])) {
+			midiOptions.finalDegree = msc::numeralsToDegrees.at(argv[++i]);
+		} else if (arg == "--lookahead" && i + 1 < argc) {
+			lookahead = std::stoul(argv[++i]);
+		} else if (arg == "--threads" && i + 1 < argc) {
+			searchOptions.threads = std::stoul(argv[++i]);
+		} else if (arg == "--fragments" && i + 1 < argc) {
+			fragmentsPath = argv[++i];
+		} else if (arg == "--refine" && i + 1 < argc) {
+			searchOptions.refineTime = std::chrono::milliseconds{ std::stol(argv[++i]) };
+		} else if (arg == "validate" && i == 1) {
+			validateOnly = true;
+		} else if (arg == "stream" && i == 1) {
+			stream = true;
+		} else if (arg == "count" && i == 1) {
+			count = true;
+		} else if (arg == "index" && i == 1) {
+			buildIndex = true;
+		} else {
+			fileName = arg;
+			fileNames.push_back(arg);
+		}
+	}
+
+	//streamed soprano notes come in as MIDI on stdin and the bass goes out as MIDI on stdout
+	if (stream) {
+		auto key = msc::keyFromName(midiOptions.keyName);
+		if (key == nullptr) {
+			std::cerr << "Error: streaming needs the key, like --key D or --key b\n";
+			return 1;
+		}
+#ifdef _WIN32
+		_setmode(_fileno(stdin), _O_BINARY);
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		msc::streamBassLine(std::cin, std::cout, *key, midiOptions.finalDegree.value_or(1), lookahead);
+		return 0;
+	}
+
+	//scores that don't name their key are read in the key that fits the soprano best
+	auto guessMissingKey = [](msc::ScoreData& score) {
+		if (score.keys.empty()) {
+			score.keys = { { 0, msc::rankKeys(score.soprano).front().key } };
+		}
+	};
+
+	//length of a chord slot, or 0 for a chord on every soprano note
+	auto slotLengthOf = [&harmonicRhythm](const msc::Meter& meter) {
+		if (harmonicRhythm == "beat") {
+			return meter.beatLength();
+		} else if (harmonicRhythm == "half") {
+			return meter.measureLength() / 2;
+		}
+		return 0;
+	};
+
+	//prints the # of valid basslines of each score, and how much the search branches at each note of a single score
+	if (count) {
+		for (const std::string& name : fileNames) {
+			auto score = msc::isMidiFile(name) ? msc::parseMidi(name, midiOptions) : msc::parseMeasures(name, parts);
+			if (score.has_value()) {
+				guessMissingKey(score.value());
+			}
+			auto solutions = score.has_value() ? msc::countBassLines(score->keys, score->soprano, score->bass, score->finalDegree, 
+				                                                     slotLengthOf(score->meter), score->waypoints) : std::nullopt;
+			if (!solutions.has_value()) {
+				std::cout << name << ": couldn't be counted\n";
+				continue;
+			}
+			std::cout << name << ": " << solutions->total.toString() << " basslines\n";
+			if (fileNames.size() == 1) {
+				std::cout << "note\tstates\tmoves\tbranching\n";
+				for (const msc::PositionStats& position : solutions->positions) {
+					std::cout << position.noteIdx << "\t" << position.states << "\t" << position.transitions << "\t" << position.branching << "\n";
+				}
+			}
+		}
+		return 0;
+	}
+
+	//the first file is the index to write, and the rest are solved scores with every bass note labeled
+	if (buildIndex) {
+		std::vector<msc::FragmentRecord> records;
+		for (size_t i = 1; i < fileNames.size(); i++) {
+			auto score = msc::isMidiFile(fileNames[i]) ? msc::parseMidi(fileNames[i], midiOptions) : msc::parseMeasures(fileNames[i], parts);
+			if (score.has_value()) {
+				guessMissingKey(score.value());
+				auto fragments = msc::collectFragments(score.value());
+				records.insert(records.end(), fragments.begin(), fragments.end());
+			}
+		}
+		size_t fragmentCount = records.size();
+		if (fileNames.empty() || !msc::writeFragmentIndex(fileNames.front(), std::move(records))) {
+			return 1;
+		}
+		std::cout << "Indexed " << fragmentCount << " fragments\n";
+		return 0;
+	}
+
+	if (fileName.empty()) {
+		std::cout << "Enter the name of your musicxml score file: ";
+		std::cin >> fileName;
+	}
 	std::replace(fileName.begin(), fileName.end(), '\\', '/');
-	info = msc::parseMeasures(fileName);
-	auto& [key, soprano, bass, degree] = info.value();
 
-	auto [newBassLine, chords] = msc::writeBassLine(key, soprano, bass, degree);
+	//counters are reported in the trace, so they start one in trace.json if none was asked for
+	if (hardwareCounters && tracePath.empty()) {
+		tracePath = "trace.json";
+	}
+	msc::TraceSession trace{ tracePath, hardwareCounters }; //written when main returns
+	bool midiInput = msc::isMidiFile(fileName);
+	info = midiInput ? msc::parseMidi(fileName, midiOptions) : msc::parseMeasures(fileName, parts);
+	if (!info.has_value()) {
+		return 1;
+	}
+	auto& score = info.value();
+
+	if (validateOnly) {
+		//with nothing to check the bass against, there's nothing to say about it
+		if (score.harmonies.empty() || score.harmonies.front().noteIdx >= score.bass.size()) {
+			std::cout << "Error: the bass part has no harmony labels to validate against\n";
+			return 1;
+		}
+		guessMissingKey(score);
+		auto violations = msc::validateLabeledBassLine(score.keys, score.soprano, score.bass, score.harmonies);
+		msc::printViolations(violations);
+		std::cout << (violations.empty() ? "The bassline follows every rule.\n" : "The bassline breaks the rules above.\n");
+		return violations.empty() ? 0 : 1;
+	}
+
+	std::optional<msc::FragmentIndex> fragments;
+	if (!fragmentsPath.empty()) {
+		fragments.emplace(fragmentsPath);
+		if (fragments->isOpen()) {
+			searchOptions.fragments = &fragments.value();
+		}
+	}
+
+	//without a key, the keys that fit the soprano best are tried at once and the cheapest bassline picks the key
+	std::optional<msc::OutputData> data;
+	if (score.keys.empty()) {
+		auto keyed = msc::writeBassLineInAnyKey(score.soprano, score.bass, score.finalDegree, slotLengthOf(score.meter), 
+			                                    score.waypoints, searchOptions);
+		if (keyed.has_value()) {
+			std::cout << "Wrote the bassline in " << keyed->key->tonic().name << (keyed->key->major ? " major" : " harmonic minor") 
+				      << ", with a cost of " << keyed->cost << "\n";
+			score.keys = { { 0, keyed->key } };
+			data = std::move(keyed->solution);
+		}
+	} else {
+		data = msc::writeBassLine(score.keys, score.soprano, score.bass, score.finalDegree, slotLengthOf(score.meter), 
+			                      score.waypoints, searchOptions);
+	}
+	if (!data.has_value()) {
+		std::cout << "I couldn't solve this one.\n";
+		return 1;
+	}
+	const msc::OutputData& solution = data.value();
+
+	//check the written bassline, starting from the last given note, before it goes into the score
+	std::vector<msc::Note> fullBassLine = score.bass;
+	auto labels = score.harmonies;
+	for (size_t i = 0; i < solution.size(); i++) {
+		fullBassLine.push_back(solution.bassNote(i));
+		labels.emplace_back(score.bass.size() + i, solution.chord(i).degree, solution.chord(i).inversion);
+	}
+	auto violations = msc::validateLabeledBassLine(score.keys, score.soprano, fullBassLine, labels);
+	if (!violations.empty()) {
+		std::cout << "Error: the written bassline breaks these rules:\n";
+		msc::printViolations(violations);
+		return 1;
+	}
 
-	msc::writeToOutputFile(fileName, newBassLine, chords, key.major);
+	//MIDI scores are written back out as MIDI, since there is no MusicXML to fill in
+	if (midiInput && midiPath.empty()) {
+		midiPath = "output.mid";
+	} else if (!midiInput) {
+		msc::writeToOutputFile(fileName, score.bassPartId, solution, score.meter);
+	}
+	if (!midiPath.empty() && !msc::writeMidiFile(midiPath, score.soprano, fullBassLine, solution, score.bass.size(), score.meter, 
+		                                           score.keys)) {
+		return 1;
+	}
 	/*try {
 		info = msc::parseMeasures("input_7.musicxml");
 		auto& [key, soprano, bass, degree] = info.value();
@@ -23,4 +244,4 @@ int main() {
 		std::cout << "Error: Bad input. Check your score for errors\n";
 		std::cout << e.what() << std::endl;
 	}*/
-}
\ No newline at end of file
+}
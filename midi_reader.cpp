@@ -0,0 +1,293 @@
+#include "midi_reader.h"
+#include "midi_writer.h"
+
+namespace {
+	struct MidiNote {
+		int64_t onset = 0;  //in ticks
+		int64_t offset = 0;
+		int pitch = 0;
+	};
+
+	//the notes of one channel of one track
+	struct Voice {
+		std::vector<MidiNote> notes;
+		std::array<int64_t, 128> activeOnsets; //onset of each sounding pitch, -1 if it isn't sounding
+	};
+
+	//reads bytes of the mapped file, failing instead of reading past the end
+	class ByteReader {
+	private:
+		std::span<const uint8_t> m_bytes;
+		size_t m_pos = 0;
+	public:
+		bool failed = false;
+
+		ByteReader(std::span<const uint8_t> bytes) : m_bytes(bytes) {}
+
+		inline bool atEnd() const {
+			return m_pos >= m_bytes.size();
+		}
+		inline size_t position() const {
+			return m_pos;
+		}
+		inline uint8_t peek() {
+			failed |= atEnd();
+			return failed ? 0 : m_bytes[m_pos];
+		}
+		inline uint8_t byte() {
+			uint8_t value = peek();
+			m_pos += !failed;
+			return value;
+		}
+		inline uint32_t bigEndian(size_t byteCount) {
+			uint32_t value = 0;
+			for (size_t i = 0; i < byteCount; i++) {
+				value = (value << 8) | byte();
+			}
+			return value;
+		}
+		//variable length quantity: 7 bits a byte, high bit set on every byte but the last
+		inline uint32_t variableLength() {
+			uint32_t value = 0;
+			for (int i = 0; i < 4; i++) {
+				uint8_t next = byte();
+				value = (value << 7) | (next & 0x7F);
+				if ((next & 0x80) == 0) {
+					return value;
+				}
+			}
+			failed = true;
+			return 0;
+		}
+		inline std::span<const uint8_t> take(size_t count) {
+			failed |= count > m_bytes.size() - std::min(m_pos, m_bytes.size());
+			if (failed) {
+				return {};
+			}
+			auto taken = m_bytes.subspan(m_pos, count);
+			m_pos += count;
+			return taken;
+		}
+	};
+
+	//key names by the # of sharps (positive) or flats (negative) of a key signature, offset by 7
+	const std::array<std::string, 15> majorKeyNames{ "Cb", "Gb", "Db", "Ab", "Eb", "Bb", "F", "C", "G", "D", "A", "E", "B", "F#", "C#" };
+	const std::array<std::string, 15> minorKeyNames{ "ab", "eb", "bb", "f", "c", "g", "d", "a", "e", "b", "f#", "c#", "g#", "d#", "a#" };
+}
+
+msc::ResultData msc::parseMidi(const std::string& path, const MidiOptions& options) {
+	MSC_TRACE_SPAN("parse midi");
+
+	MappedFile file{ path };
+	if (!file.isOpen()) {
+		std::cout << "Error: file is not open\n";
+		return {};
+	}
+	ByteReader reader{ file.bytes() };
+
+	auto header = reader.take(4);
+	if (reader.failed || !std::equal(header.begin(), header.end(), "MThd")) {
+		std::cout << "Error: " << path << " is not a MIDI file\n";
+		return {};
+	}
+	uint32_t headerLength = reader.bigEndian(4);
+	reader.bigEndian(2); //format 0 and 1 files both work, since voices are split by channel
+	uint32_t trackCount = reader.bigEndian(2);
+	int64_t ticksPerQuarter = reader.bigEndian(2);
+	reader.take(headerLength - 6);
+	if (ticksPerQuarter == 0 || (ticksPerQuarter & 0x8000) != 0) {
+		std::cout << "Error: MIDI files timed in SMPTE frames are not supported\n";
+		return {};
+	}
+
+	std::vector<Voice> voices;
+	std::map<int, size_t> voiceIdx; //voices by track * 16 + channel, in order of their first note
+	std::vector<std::pair<int64_t, std::string>> keyChanges;
+	std::vector<std::pair<int64_t, int>> numerals;
+	Meter meter{ options.divisions };
+
+	//every track is read in one pass over the mapped bytes
+	for (uint32_t track = 0; track < trackCount && !reader.failed && !reader.atEnd(); track++) {
+		auto chunkType = reader.take(4);
+		size_t chunkLength = reader.bigEndian(4);
+		size_t chunkEnd = reader.position() + chunkLength;
+		if (!std::equal(chunkType.begin(), chunkType.end(), "MTrk")) { //unknown chunks are skipped
+			reader.take(chunkLength);
+			track--;
+			continue;
+		}
+
+		int64_t tick = 0;
+		uint8_t status = 0;
+		while (!reader.failed && reader.position() < chunkEnd) {
+			tick += reader.variableLength();
+			if (reader.peek() & 0x80) {
+				status = reader.byte();
+			} //otherwise running status, the data starts right away
+
+			if (status == 0xFF) {
+				uint8_t type = reader.byte();
+				auto data = reader.take(reader.variableLength());
+				if (type == 0x59 && data.size() >= 2) { //key signature
+					int sharps = std::clamp(static_cast<int>(static_cast<int8_t>(data[0])), -7, 7);
+					keyChanges.emplace_back(tick, (data[1] == 0 ? majorKeyNames : minorKeyNames)[static_cast<size_t>(sharps + 7)]);
+				} else if (type == 0x58 && data.size() >= 2) { //time signature
+					meter.beats = data[0];
+					meter.beatType = 1 << data[1];
+				} else if (type == 0x01 || type == 0x05 || type == 0x06) { //text, lyric, marker
+					std::string text{ data.begin(), data.end() };
+					if (numeralsToDegrees.contains(text)) {
+						numerals.emplace_back(tick, numeralsToDegrees.at(text));
+					}
+				}
+				status = 0; //meta and sysex events cancel running status
+				continue;
+			} else if (status == 0xF0 || status == 0xF7) {
+				reader.take(reader.variableLength());
+				status = 0;
+				continue;
+			} else if (status < 0x80) {
+				reader.failed = true;
+				break;
+			}
+
+			uint8_t type = status & 0xF0;
+			uint8_t first = reader.byte();
+			uint8_t second = type == 0xC0 || type == 0xD0 ? 0 : reader.byte();
+			if (type != 0x80 && type != 0x90) {
+				continue;
+			}
+
+			int voiceKey = static_cast<int>(track) * 16 + (status & 0x0F);
+			auto [voiceIt, newVoice] = voiceIdx.try_emplace(voiceKey, voices.size());
+			if (newVoice) {
+				voices.emplace_back().activeOnsets.fill(-1);
+			}
+			Voice& voice = voices[voiceIt->second];
+			int64_t& activeOnset = voice.activeOnsets[first & 0x7F];
+
+			if (type == 0x90 && second > 0) {
+				if (activeOnset >= 0) { //a repeated note ends the one that is still sounding
+					voice.notes.emplace_back(activeOnset, tick, first);
+				}
+				activeOnset = tick;
+			} else if (activeOnset >= 0) {
+				voice.notes.emplace_back(activeOnset, tick, first);
+				activeOnset = -1;
+			}
+		}
+	}
+	if (reader.failed) {
+		std::cout << "Error: " << path << " is cut off or malformed\n";
+		return {};
+	}
+	if (voices.size() <= std::max(options.sopranoVoice, options.bassVoice)) {
+		std::cout << "Error: " << path << " has " << voices.size() << " voices with notes, which isn't enough for a soprano and bass\n";
+		return {};
+	}
+
+	auto quantize = [&](int64_t tick) {
+		return static_cast<int>((tick * options.divisions + ticksPerQuarter / 2) / ticksPerQuarter);
+	};
+
+	//quantized onsets of the notes of each line, so key changes and numerals can be placed on them
+	std::vector<int> sopranoOnsets, bassOnsets;
+
+	//reduces a voice to one note at a time, keeping the top or bottom note of notes that start together
+	auto makeLine = [&](Voice& voice, const Key& key, bool top, std::vector<int>& onsets) {
+		std::ranges::sort(voice.notes, [top](const MidiNote& a, const MidiNote& b) {
+			return a.onset != b.onset ? a.onset < b.onset : (top ? a.pitch > b.pitch : a.pitch < b.pitch);
+		});
+
+		std::vector<Note> line;
+		int lastOffset = 0;
+		for (const MidiNote& midiNote : voice.notes) {
+			int onset = quantize(midiNote.onset);
+			if (!onsets.empty() && onset == onsets.back()) {
+				continue;
+			}
+			if (!line.empty()) {
+				line.back().duration = onset - onsets.back();
+			}
+			line.push_back(key.spell(midiNote.pitch - MIDI_PITCH_OFFSET));
+			onsets.push_back(onset);
+			lastOffset = std::max(quantize(midiNote.offset), onset + 1);
+		}
+		if (!line.empty()) {
+			line.back().duration = lastOffset - onsets.back();
+		}
+		return line;
+	};
+
+	std::vector<KeySegment> keys;
+	if (!options.keyName.empty()) {
+		keyChanges = { { 0, options.keyName } };
+	}
+	if (keyChanges.empty()) {
+		std::cout << "Error: no key was provided! Add a key signature to the MIDI file or pass the key's name,\n";
+		std::cout << "uppercase for major and lowercase for harmonic minor. Ex: C#  = C# major, d = d harmonic minor.\n";
+		return {};
+	}
+	std::ranges::stable_sort(keyChanges, {}, &std::pair<int64_t, std::string>::first);
+
+	for (const auto& [tick, name] : keyChanges) {
+		if (keyFromName(name) == nullptr) {
+			std::cout << "Error: " << name << " is not a key\n";
+			return {};
+		}
+	}
+
+	//notes are spelled in the opening key, and again in their own key once the segments are known
+	auto openingKey = keyFromName(keyChanges.front().second);
+
+	ScoreData score;
+	score.soprano = makeLine(voices[options.sopranoVoice], *openingKey, true, sopranoOnsets);
+	score.bass = makeLine(voices[options.bassVoice], *openingKey, false, bassOnsets);
+	score.meter = meter;
+
+	//a key change starts a segment at the first soprano note that starts with or after it
+	for (const auto& [tick, name] : keyChanges) {
+		size_t noteIdx = std::ranges::lower_bound(sopranoOnsets, quantize(tick)) - sopranoOnsets.begin();
+		auto key = keyFromName(name);
+		if (!keys.empty() && keys.back().noteIdx == noteIdx) {
+			keys.back().key = key;
+		} else {
+			keys.emplace_back(noteIdx, key);
+		}
+	}
+	keys.front().noteIdx = 0;
+
+	//respell both lines in the key each note sounds in
+	auto respell = [&keys, &sopranoOnsets](std::vector<Note>& line, const std::vector<int>& onsets) {
+		size_t keyIdx = 0;
+		for (size_t i = 0; i < line.size(); i++) {
+			while (keyIdx + 1 < keys.size() && keys[keyIdx + 1].noteIdx < sopranoOnsets.size() && 
+				   sopranoOnsets[keys[keyIdx + 1].noteIdx] <= onsets[i]) 
+			{
+				keyIdx++;
+			}
+			int duration = line[i].duration;
+			line[i] = keys[keyIdx].key->spell(line[i].pitch);
+			line[i].duration = duration;
+		}
+	};
+	respell(score.soprano, sopranoOnsets);
+	respell(score.bass, bassOnsets);
+	score.keys = std::move(keys);
+
+	//numerals over the given bass label it, and the ones after it are waypoints of the soprano
+	for (const auto& [tick, degree] : numerals) {
+		auto onsetIt = std::ranges::find(bassOnsets, quantize(tick));
+		auto sopranoOnsetIt = std::ranges::find(sopranoOnsets, quantize(tick));
+		if (onsetIt != bassOnsets.end()) {
+			score.harmonies.emplace_back(static_cast<size_t>(onsetIt - bassOnsets.begin()), degree);
+		} else if (sopranoOnsetIt != sopranoOnsets.end()) {
+			score.waypoints.emplace_back(static_cast<size_t>(sopranoOnsetIt - sopranoOnsets.begin()), degree);
+		}
+	}
+
+	//the given bassline ends on the chord of its last numeral, like the last bass <function> of a MusicXML score
+	score.finalDegree = !score.harmonies.empty() ? score.harmonies.back().degree : options.finalDegree.value_or(1);
+
+	return score;
+}
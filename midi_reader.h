@@ -0,0 +1,32 @@
+#pragma once
+
+#include <optional>
+#include <string>
+
+#include "parser.h"
+
+namespace msc {
+	//inputs a MIDI file may not have, and how its notes are read
+	struct MidiOptions {
+		std::string keyName;            //like "D" or "b". Overrides the key signatures of the file if given
+		std::optional<int> finalDegree; //chord the given bassline ends on, if no roman numeral text event is over it
+		size_t sopranoVoice = 0; //index of the soprano among the tracks and channels that have notes
+		size_t bassVoice = 1;
+		int divisions = 4; //onsets and lengths are rounded to this many steps of a quarter note
+	};
+
+	/*
+	* Reads a Standard MIDI File into the same data as parseMeasures.
+	* Every track and channel with notes is a voice. Overlapping notes are reduced to the top note in the
+	* soprano and the bottom note in the bass, and each note lasts until the next one so rests are absorbed.
+	* Keys come from key signature events and the final degree from the first roman numeral text, lyric or
+	* marker event, unless options give them. Other numerals label the bass notes they start with, 
+	* and the ones after the bass are waypoints of the soprano notes they start with.
+	* Without a numeral or option the final degree is the tonic.
+	*/
+	ResultData parseMidi(const std::string& path, const MidiOptions& options = {});
+
+	inline bool isMidiFile(const std::string& path) {
+		return path.ends_with(".mid") || path.ends_with(".midi");
+	}
+}
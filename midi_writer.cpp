@@ -0,0 +1,198 @@
+#include "midi_writer.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <fstream>
+#include <map>
+#include <string_view>
+
+namespace {
+	constexpr uint8_t NOTE_ON = 0x90;
+	constexpr uint8_t VELOCITY = 80;
+	constexpr int CHORD_LOWEST_PITCH = 55 - msc::MIDI_PITCH_OFFSET; //chord tones go between G3 and F#4
+
+	//numerals written over the chords, indexed by degree - GERMAN_SIXTH_DEGREE, in major then minor. Degree 0 isn't a chord
+	constexpr std::array<std::array<std::string_view, 16>, 2> NUMERALS{ {
+		{ "Ger+6", "Fr+6", "It+6", "N", "viio7", "V/IV", "V/vi", "V/V", "", "I", "ii", "iii", "IV", "V", "vi", "vii" },
+		{ "Ger+6", "Fr+6", "It+6", "N", "viio7", "V/iv", "V/VI", "V/V", "", "i", "ii", "III", "iv", "V", "VI", "vii" }
+	} };
+
+	constexpr std::string_view numeralOf(int degree, bool major) {
+		return NUMERALS[major ? 0 : 1][static_cast<size_t>(degree - msc::GERMAN_SIXTH_DEGREE)];
+	}
+
+	//a track of the file being written. Offs are written as ons with no velocity so the running status never changes
+	class TrackWriter {
+	private:
+		std::vector<uint8_t>& m_buffer;
+		size_t m_lengthIdx = 0;
+		int m_pendingTicks = 0; //time since the last event
+		uint8_t m_status = 0;
+	public:
+		TrackWriter(std::vector<uint8_t>& buffer) : m_buffer(buffer) {
+			m_buffer.insert(m_buffer.end(), { 'M', 'T', 'r', 'k', 0, 0, 0, 0 });
+			m_lengthIdx = m_buffer.size() - 4;
+		}
+
+		inline void push32(uint32_t value) {
+			m_buffer.insert(m_buffer.end(), { static_cast<uint8_t>(value >> 24), static_cast<uint8_t>(value >> 16),
+				                              static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value) });
+		}
+
+		//variable length quantities, 7 bits a byte with the high bit set on every byte but the last
+		void pushVlq(uint32_t value) {
+			int shift = (std::bit_width(value | 1) - 1) / 7 * 7;
+			for (; shift > 0; shift -= 7) {
+				m_buffer.push_back(static_cast<uint8_t>(0x80 | ((value >> shift) & 0x7F)));
+			}
+			m_buffer.push_back(static_cast<uint8_t>(value & 0x7F));
+		}
+
+		inline void pushDelta() {
+			pushVlq(static_cast<uint32_t>(m_pendingTicks));
+			m_pendingTicks = 0;
+		}
+
+		inline void wait(int ticks) {
+			m_pendingTicks += ticks;
+		}
+
+		void note(uint8_t channel, int pitch, uint8_t velocity) {
+			pushDelta();
+			uint8_t status = NOTE_ON | channel;
+			if (status != m_status) {
+				m_buffer.push_back(status);
+				m_status = status;
+			}
+			m_buffer.push_back(static_cast<uint8_t>(std::clamp(pitch + msc::MIDI_PITCH_OFFSET, 0, 127)));
+			m_buffer.push_back(velocity);
+		}
+
+		void meta(uint8_t type, std::initializer_list<uint8_t> data) {
+			pushDelta();
+			m_buffer.insert(m_buffer.end(), { 0xFF, type });
+			pushVlq(static_cast<uint32_t>(data.size()));
+			m_buffer.insert(m_buffer.end(), data);
+			m_status = 0; //meta events cancel running status
+		}
+
+		void meta(uint8_t type, std::string_view text) {
+			pushDelta();
+			m_buffer.insert(m_buffer.end(), { 0xFF, type });
+			pushVlq(static_cast<uint32_t>(text.size()));
+			m_buffer.insert(m_buffer.end(), text.begin(), text.end());
+			m_status = 0;
+		}
+
+		//ends the track and fills in its length
+		void finish() {
+			meta(0x2F, {});
+			uint32_t length = static_cast<uint32_t>(m_buffer.size() - m_lengthIdx - 4);
+			for (size_t i = 0; i < 4; i++) {
+				m_buffer[m_lengthIdx + i] = static_cast<uint8_t>(length >> (24 - 8 * i));
+			}
+		}
+	};
+
+	void writeLine(std::vector<uint8_t>& buffer, std::span<const msc::Note> line, uint8_t channel) {
+		TrackWriter track{ buffer };
+		for (const msc::Note& note : line) {
+			track.note(channel, note.pitch, VELOCITY);
+			track.wait(note.duration);
+			track.note(channel, note.pitch, 0);
+		}
+		track.finish();
+	}
+}
+
+int msc::keySignatureSharps(const Key& key) {
+	//letters by their place in the circle of fifths from C. Each sharp on the tonic adds 7 sharps, and each flat takes 7 away
+	static const std::map<char, int> fifthsFromC{ { 'F', -1 }, { 'C', 0 }, { 'G', 1 }, { 'D', 2 }, { 'A', 3 }, { 'E', 4 }, { 'B', 5 } };
+	const std::string& tonic = key.tonic().name;
+	int sharps = fifthsFromC.at(tonic[0]);
+	for (size_t i = 1; i < tonic.size(); i++) {
+		sharps += tonic[i] == '#' ? 7 : -7;
+	}
+	if (!key.major) { //a minor key has the signature of its relative major, a minor third up
+		sharps -= 3;
+	}
+	return std::clamp(sharps, -7, 7);
+}
+
+std::vector<uint8_t> msc::makeMidi(std::span<const Note> sopranoLine, std::span<const Note> bassLine, 
+	                               const OutputData& solution, size_t chordStartIdx, const Meter& meter, 
+	                               std::span<const KeySegment> keys, int tempo)
+{
+	std::vector<uint8_t> buffer;
+	//a note on and off take about 8 bytes, and the header and tempo track take about 60
+	buffer.reserve(64 + 8 * (sopranoLine.size() + bassLine.size() + MAX_CHORD_TONES * solution.size()));
+
+	//header: format 1, 4 tracks, divisions per quarter note
+	buffer.insert(buffer.end(), { 'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1, 0, 4, 
+		                          static_cast<uint8_t>(meter.divisions >> 8), static_cast<uint8_t>(meter.divisions) });
+
+	{
+		TrackWriter track{ buffer };
+		uint32_t microsecondsPerQuarter = 60'000'000 / static_cast<uint32_t>(tempo);
+		track.meta(0x51, { static_cast<uint8_t>(microsecondsPerQuarter >> 16), static_cast<uint8_t>(microsecondsPerQuarter >> 8),
+			               static_cast<uint8_t>(microsecondsPerQuarter) });
+		track.meta(0x58, { static_cast<uint8_t>(meter.beats), static_cast<uint8_t>(std::bit_width(static_cast<unsigned>(meter.beatType)) - 1),
+			               24, 8 });
+
+		//each key segment starts at the onset of its first soprano note
+		size_t noteIdx = 0;
+		for (const KeySegment& segment : keys) {
+			for (; noteIdx < segment.noteIdx && noteIdx < sopranoLine.size(); noteIdx++) {
+				track.wait(sopranoLine[noteIdx].duration);
+			}
+			track.meta(0x59, { static_cast<uint8_t>(static_cast<int8_t>(keySignatureSharps(*segment.key))), 
+				               static_cast<uint8_t>(segment.key->major ? 0 : 1) });
+		}
+		track.finish();
+	}
+
+	writeLine(buffer, sopranoLine, 0);
+	writeLine(buffer, bassLine, 1);
+
+	//the chords wait for the bass notes that come before them, then sound for as long as their bass note
+	TrackWriter track{ buffer };
+	for (size_t i = 0; i < chordStartIdx && i < bassLine.size(); i++) {
+		track.wait(bassLine[i].duration);
+	}
+	auto chordPitch = [](const Note& note) {
+		return CHORD_LOWEST_PITCH + (pitchClass(note) - CHORD_LOWEST_PITCH % 12 + 12) % 12;
+	};
+	for (size_t i = 0; i < solution.size() && chordStartIdx + i < bassLine.size(); i++) {
+		//the numeral goes over the chord as a lyric, so the file can be validated when it's read back
+		const Chord& chord = solution.chord(i);
+		track.meta(0x05, numeralOf(chord.degree, solution.key(i).major));
+		for (const Note& note : solution.chord(i).notes) {
+			track.note(2, chordPitch(note), VELOCITY);
+		}
+		track.wait(bassLine[chordStartIdx + i].duration);
+		for (const Note& note : solution.chord(i).notes) {
+			track.note(2, chordPitch(note), 0);
+		}
+	}
+	track.finish();
+
+	return buffer;
+}
+
+bool msc::writeMidiFile(const std::string& filePath, std::span<const Note> sopranoLine, std::span<const Note> bassLine, 
+	                    const OutputData& solution, size_t chordStartIdx, const Meter& meter, 
+	                    std::span<const KeySegment> keys, int tempo)
+{
+	MSC_TRACE_SPAN("write midi");
+
+	auto buffer = makeMidi(sopranoLine, bassLine, solution, chordStartIdx, meter, keys, tempo);
+
+	std::ofstream file{ filePath, std::ios::binary };
+	if (!file) {
+		std::cout << "Error: couldn't write " << filePath << std::endl;
+		return false;
+	}
+	file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+	return static_cast<bool>(file);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "bassline_maker.h"
+
+namespace msc {
+	inline constexpr int MIDI_PITCH_OFFSET = 12; //pitch 0 is C0, which is MIDI note 12
+	inline constexpr int DEFAULT_TEMPO = 100;    //quarter notes per minute
+
+	//# of sharps (positive) or flats (negative) in the key signature of key
+	int keySignatureSharps(const Key& key);
+
+	/*builds a Standard MIDI File with a tempo track, then one track each for the soprano, the bass, and 
+	the upper notes of the chords. The i-th chord of the solution sounds with bassLine[chordStartIdx + i]. Ticks are the 
+	divisions of the meter, so the durations of the notes are written as they are. The tempo track has a key signature 
+	where each key segment starts, and each chord has its numeral as a lyric, so the file reads back
+	in the same keys and can be validated*/
+	std::vector<uint8_t> makeMidi(std::span<const Note> sopranoLine, std::span<const Note> bassLine, 
+		                          const OutputData& solution, size_t chordStartIdx, const Meter& meter, 
+		                          std::span<const KeySegment> keys, int tempo = DEFAULT_TEMPO);
+
+	//writes the file made by makeMidi. Returns false if the file couldn't be written
+	bool writeMidiFile(const std::string& filePath, std::span<const Note> sopranoLine, std::span<const Note> bassLine, 
+		               const OutputData& solution, size_t chordStartIdx, const Meter& meter, std::span<const KeySegment> keys, 
+		               int tempo = DEFAULT_TEMPO);
+}
@@ -1,6 +1,39 @@
 #include "output_writer.h"
 
-void msc::writeToOutputFile(std::string filePath, const std::vector<Note>& bassLine, const std::vector<Chord>& chords, bool major) {
+std::pair<std::string, int> msc::noteTypeOf(int duration, int divisions) {
+	//note types from longest to shortest, with their length in 16ths of a quarter note
+	static const std::array<std::pair<std::string, int>, 7> noteTypes{ {
+		{ "whole", 64 }, { "half", 32 }, { "quarter", 16 }, { "eighth", 8 }, 
+		{ "16th", 4 }, { "32nd", 2 }, { "64th", 1 }
+	} };
+
+	//compare lengths in 64ths of a division so that every comparison is exact
+	long long length = static_cast<long long>(duration) * 64;
+	for (const auto& [type, sixteenths] : noteTypes) {
+		long long typeLength = static_cast<long long>(divisions) * sixteenths * 4;
+		if (length == typeLength) {
+			return { type, 0 };
+		} else if (2 * length == 3 * typeLength) {
+			return { type, 1 };
+		} else if (4 * length == 7 * typeLength) {
+			return { type, 2 };
+		}
+	}
+
+	//tuplets and other lengths fall back to the longest type that fits
+	for (const auto& [type, sixteenths] : noteTypes) {
+		if (length >= static_cast<long long>(divisions) * sixteenths * 4) {
+			return { type, 0 };
+		}
+	}
+	return { noteTypes.back().first, 0 };
+}
+
+void msc::writeToOutputFile(std::string filePath, const std::string& bassPartId, const OutputData& solution, 
+	                           const Meter& meter) 
+{
+	MSC_TRACE_SPAN("write output");
+
 	std::fstream file;
 	file.open(filePath);
 
@@ -20,11 +53,10 @@ void msc::writeToOutputFile(std::string filePath, const std::vector<Note>& bassL
 		line.erase(std::remove_if(line.begin(), line.end(), std::isspace), line.end());
 	}
 
-	//get line where the # of beats is specified
-	StringVecIt it = std::find_if(parsedLines.begin(), parsedLines.end(), [](const std::string& string) { return string.contains("<beats>"); });
-	int beatCount = std::stoi(enclosedString(*it, '>', '<')) * 4;
+	int beatCount = meter.measureLength(); //length of a measure
 
-	auto writeNoteData = [](const Note& note) -> std::vector<std::string> { 
+	//tieStart and tieStop tie the note to the pieces of the same bass note in the measures around it
+	auto writeNoteData = [&meter](const Note& note, bool tieStart, bool tieStop) -> std::vector<std::string> { 
 		std::vector<std::string> ret;
 
 		ret.push_back("<note>"); //add opening note attribute
@@ -56,37 +88,42 @@ void msc::writeToOutputFile(std::string filePath, const std::vector<Note>& bassL
 
 		ret.push_back("</pitch>"); //add closing pitch attributes
 
-		std::string durationAttribute = makeAttribute("duration", "1"); //duration will always equal 1
+		std::string durationAttribute = makeAttribute("duration", std::to_string(note.duration));
 		ret.push_back(durationAttribute); //add duration attribute
+		if (tieStop) {
+			ret.push_back("<tie type=\"stop\"/>");
+		}
+		if (tieStart) {
+			ret.push_back("<tie type=\"start\"/>");
+		}
 		
 		std::string voiceAttribute = makeAttribute("voice", "1");
 		ret.push_back(voiceAttribute); //add voice attribute
 
-		std::string noteType;
-		switch (note.duration) {
-		case 2:
-			noteType = "eighth";
-			break;
-		case 4:
-			noteType = "quarter";
-			break;
-		case 8:
-			noteType = "half";
-			break;
-		case 16:
-			noteType = "whole";
-			break;
-		}
+		auto [noteType, dots] = noteTypeOf(note.duration, meter.divisions);
 
 		std::string noteTypeAttribute = makeAttribute("type", noteType);
 		ret.push_back(noteTypeAttribute);
+		for (int i = 0; i < dots; i++) {
+			ret.push_back("<dot/>");
+		}
 		ret.push_back("<staff>1</staff>");
+		if (tieStart || tieStop) {
+			ret.push_back("<notations>");
+			if (tieStop) {
+				ret.push_back("<tied type=\"stop\"/>");
+			}
+			if (tieStart) {
+				ret.push_back("<tied type=\"start\"/>");
+			}
+			ret.push_back("</notations>");
+		}
 		ret.push_back("</note>"); //add closing note attribute
 
 		return ret;
 	};
 
-	auto writeChordData = [major](const Chord& chord) {
+	auto writeChordData = [](const Chord& chord, bool major) {
 		StringVec ret;
 
 		//write chord data
@@ -95,15 +132,28 @@ void msc::writeToOutputFile(std::string filePath, const std::vector<Note>& bassL
 		if (chord.degree == SECONDARY_DOM_DEGREE) { //put second function if V/V
 			ret.push_back(makeAttribute("function", chordNames[{chord.degree, major}]));
 		}
+		//chromatic chords have their own kinds
+		static const std::map<int, std::string> chromaticKinds{
+			{ SECONDARY_DOM_OF_FOUR_DEGREE, "dominant" },
+			{ DIMINISHED_SEVENTH_DEGREE, "diminished-seventh" },
+			{ NEAPOLITAN_DEGREE, "Neapolitan" },
+			{ ITALIAN_SIXTH_DEGREE, "Italian" },
+			{ FRENCH_SIXTH_DEGREE, "French" },
+			{ GERMAN_SIXTH_DEGREE, "German" }
+		};
 		std::string name;
-		if (chord.inversion == 3 && chord.degree == 5) {
+		if (chromaticKinds.contains(chord.degree)) {
+			name = chromaticKinds.at(chord.degree);
+		} else if (chord.degree < 0) { //secondary dominant triads
+			name = "major";
+		} else if (chord.inversion == 3 && chord.degree == 5) {
 			name = "dominant";
 		} else if (islower(chordNames[{chord.degree, major}][0])) {
 			name = "minor";
 		} else {
 			name = "major";
 		}
-		if (chord.degree != 5 && (chord.inversion == 3 || (chord.inversion == 2 && (chord.degree == 2 && chord.degree == 5)))) {
+		if (chord.degree > 0 && chord.degree != 5 && (chord.inversion == 3 || (chord.inversion == 2 && (chord.degree == 2 && chord.degree == 5)))) {
 			name.append("-seventh");
 		}
 	
@@ -115,8 +165,9 @@ void msc::writeToOutputFile(std::string filePath, const std::vector<Note>& bassL
 		return ret;
 	};
 
-	//find the measure where the rests start
-	it = std::find(parsedLines.begin(), parsedLines.end(), "<rest/>");
+	//find the measure where the rests of the bass part start
+	auto bassPartIt = std::find(parsedLines.begin(), parsedLines.end(), "<partid=\"" + bassPartId + "\">");
+	StringVecIt it = std::find(bassPartIt, parsedLines.end(), "<rest/>");
 	skipToLine(it, parsedLines.begin(), "measurenumber", - 1);
 	
 	int measureCount = std::stoi(enclosedString(*it, '"', '"'));
@@ -125,49 +176,56 @@ void msc::writeToOutputFile(std::string filePath, const std::vector<Note>& bassL
 
 	//write measure attributes
 	std::vector<std::string> measureAttributes; 
-	for (size_t i = 0; i < bassLine.size(); i++) {
-		if (beatsPassed == beatCount) {
-			beatsPassed = 0;
-			measureAttributes.push_back("</measure>");
-			measureCount++;
-		}
-		if (beatsPassed == 0) {
-			std::string measureNameAttribute = std::string("<measure number=\"") + std::to_string(measureCount) + "\">";
-			measureAttributes.push_back(measureNameAttribute);
-		}
+	for (size_t i = 0; i < solution.size(); i++) {
+		/*a bass note that crosses a barline, like one under a tied soprano note or a harmonic rhythm slot, 
+		is split at the barline and its pieces are tied together*/
+		Note bass = solution.bassNote(i);
+		int remaining = bass.duration;
+		bool firstPiece = true;
+		while (firstPiece || remaining > 0) {
+			if (beatsPassed >= beatCount) {
+				beatsPassed -= beatCount;
+				measureAttributes.push_back("</measure>");
+				measureCount++;
+			}
+			if (beatsPassed == 0) {
+				std::string measureNameAttribute = std::string("<measure number=\"") + std::to_string(measureCount) + "\">";
+				measureAttributes.push_back(measureNameAttribute);
+			}
+			if (i == 0 && firstPiece) { //durations are written in the divisions of the whole score, which may differ from the bass part's
+				measureAttributes.push_back("<attributes>");
+				measureAttributes.push_back(makeAttribute("divisions", std::to_string(meter.divisions)));
+				measureAttributes.push_back("</attributes>");
+			}
 
-		auto chordAttribute = writeChordData(chords[i]);
-		measureAttributes.insert(measureAttributes.end(), chordAttribute.begin(), chordAttribute.end());
+			if (firstPiece) { //the chord is labeled once, on its first piece
+				auto chordAttribute = writeChordData(solution.chord(i), solution.key(i).major);
+				measureAttributes.insert(measureAttributes.end(), chordAttribute.begin(), chordAttribute.end());
+			}
 
-		auto noteAttribute = writeNoteData(bassLine[i]);
-		measureAttributes.insert(measureAttributes.end(), noteAttribute.begin(), noteAttribute.end());
+			Note piece = bass;
+			piece.duration = std::min(remaining, beatCount - beatsPassed);
+			remaining -= piece.duration;
+			auto noteAttribute = writeNoteData(piece, remaining > 0, !firstPiece);
+			measureAttributes.insert(measureAttributes.end(), noteAttribute.begin(), noteAttribute.end());
 
-		beatsPassed += bassLine[i].duration;
+			beatsPassed += piece.duration;
+			firstPiece = false;
+		}
 	}
 
-	for (const Note& note : bassLine) {
-		
-	}
 	measureAttributes.push_back("</measure>");
 
-	auto newIt = std::find_if(originalLines.begin(), originalLines.end(), 
-		[](const std::string& str) { return str.contains("<rest/>"); }
-	);
-	skipToLine(newIt, originalLines.begin(), "number", -1);
-	auto partIt = newIt; //INTENTIONAL COPY
-	skipToLine(partIt, originalLines.end(), "part", 1);
-
-	originalLines.erase(newIt, partIt);
-	auto l = originalLines.back();
-	auto pl = originalLines[originalLines.size() - 2];
-
-	originalLines.pop_back();
-	originalLines.pop_back();
+	//replace the measures from the first rest to the end of the bass part with the written measures.
+	//parsedLines and originalLines hold the same lines, so their indices line up
+	auto partEndIt = it; //INTENTIONAL COPY
+	skipToLine(partEndIt, parsedLines.end(), "</part>", 1);
 
-	originalLines.insert(originalLines.end(), measureAttributes.begin(), measureAttributes.end());
+	auto newIt = originalLines.begin() + std::distance(parsedLines.begin(), it);
+	auto partIt = originalLines.begin() + std::distance(parsedLines.begin(), partEndIt);
 
-	originalLines.push_back(pl);
-	originalLines.push_back(l);
+	newIt = originalLines.erase(newIt, partIt);
+	originalLines.insert(newIt, measureAttributes.begin(), measureAttributes.end());
 
 	std::remove("output.musicxml");
 	std::ofstream output("output.musicxml");
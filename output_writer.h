@@ -4,6 +4,7 @@
 #include <string>
 
 #include "types.h"
+#include "bassline_maker.h"
 #include "file_util.h"
 
 namespace msc {
@@ -12,6 +13,22 @@ namespace msc {
 		{ {-1, true }, "V"},
 		{ {-1, false }, "V"},
 
+		//chromatic chords
+		{ { SECONDARY_DOM_OF_SIX_DEGREE, true }, "V/vi" },
+		{ { SECONDARY_DOM_OF_SIX_DEGREE, false }, "V/VI" },
+		{ { SECONDARY_DOM_OF_FOUR_DEGREE, true }, "V/IV" },
+		{ { SECONDARY_DOM_OF_FOUR_DEGREE, false }, "V/iv" },
+		{ { DIMINISHED_SEVENTH_DEGREE, true }, "viio7" },
+		{ { DIMINISHED_SEVENTH_DEGREE, false }, "viio7" },
+		{ { NEAPOLITAN_DEGREE, true }, "N" },
+		{ { NEAPOLITAN_DEGREE, false }, "N" },
+		{ { ITALIAN_SIXTH_DEGREE, true }, "It+6" },
+		{ { ITALIAN_SIXTH_DEGREE, false }, "It+6" },
+		{ { FRENCH_SIXTH_DEGREE, true }, "Fr+6" },
+		{ { FRENCH_SIXTH_DEGREE, false }, "Fr+6" },
+		{ { GERMAN_SIXTH_DEGREE, true }, "Ger+6" },
+		{ { GERMAN_SIXTH_DEGREE, false }, "Ger+6" },
+
 		//major chords
 		{ { 1, true }, "I" },
 		{ { 2, true }, "ii" },
@@ -31,5 +48,9 @@ namespace msc {
 		{ { 7, false }, "vii" }
 	};
 
-	void writeToOutputFile(std::string filePath, const std::vector<Note>& bassLine, const std::vector<Chord>& chords, bool major);
+	//returns the note type (quarter, half, etc) and # of dots of a duration measured in divisions of a quarter note
+	std::pair<std::string, int> noteTypeOf(int duration, int divisions);
+
+	//writes the bassline into the measures of the bass part that start with rests
+	void writeToOutputFile(std::string filePath, const std::string& bassPartId, const OutputData& solution, const Meter& meter);
 }
\ No newline at end of file
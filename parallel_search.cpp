@@ -0,0 +1,311 @@
+#include "parallel_search.h"
+#include "fragment_index.h"
+
+#include <bit>
+#include <mutex>
+#include <thread>
+#include <random>
+
+msc::FailedStateTable::FailedStateTable(size_t capacity) : m_slots(std::bit_ceil(std::max<size_t>(capacity, 64))) {
+	m_mask = m_slots.size() - 1;
+}
+
+void msc::FailedStateTable::insert(uint64_t state) {
+	uint64_t hash = state * 0x9E3779B97F4A7C15ull; //fibonacci hashing spreads the packed fields over the table
+	for (size_t probe = 0; probe < MAX_PROBES; probe++) {
+		std::atomic<uint64_t>& slot = m_slots[(hash + probe) & m_mask];
+		uint64_t expected = 0;
+		if (slot.compare_exchange_strong(expected, state, std::memory_order_relaxed) || expected == state) {
+			return;
+		}
+	}
+}
+
+bool msc::FailedStateTable::contains(uint64_t state) const {
+	uint64_t hash = state * 0x9E3779B97F4A7C15ull;
+	for (size_t probe = 0; probe < MAX_PROBES; probe++) {
+		uint64_t value = m_slots[(hash + probe) & m_mask].load(std::memory_order_relaxed);
+		if (value == state) {
+			return true;
+		} else if (value == 0) {
+			return false;
+		}
+	}
+	return false;
+}
+
+namespace {
+	using namespace msc;
+
+	//a chord and bass note at a note of the span
+	struct SearchNode {
+		const Chord* chord = nullptr;
+		Note bass;
+		size_t noteIdx = 0;
+
+		//never 0, which marks empty slots of the failed state table
+		inline uint64_t key() const {
+			return (static_cast<uint64_t>(noteIdx) << 24 | static_cast<uint64_t>(chord->id + 1) << 16 | 
+				    static_cast<uint64_t>(chord->inversion) << 8 | static_cast<uint64_t>(bass.pitch & 0xFF)) + 1;
+		}
+	};
+
+	/*the subtrees of a state that were handed to other tasks. pending counts them, plus one for the search 
+	that is still looking at the state. When it drops to 0 none of them succeeded, so the state failed*/
+	struct TaskGroup {
+		uint64_t state = 0;
+		std::shared_ptr<TaskGroup> parent;
+		std::atomic<int> pending = 1;
+	};
+
+	struct SearchTask {
+		SearchNode node;
+		std::vector<SolutionStep> path; //steps up to and including node
+		std::shared_ptr<TaskGroup> parent;
+	};
+
+	enum class Outcome {
+		SOLVED,
+		FAILED,
+		DEFERRED, //some subtrees were handed to other tasks
+		CANCELLED //another thread found a solution
+	};
+
+	class ParallelSearch {
+	private:
+		//a deque that its owner pushes and pops at the back, while thieves take from the front
+		struct Worker {
+			std::mutex mutex;
+			std::deque<SearchTask> tasks;
+		};
+
+		const KeySpan& m_span;
+		std::span<const Note> m_soprano;
+		std::optional<BassState> m_endState;
+		size_t m_goal = 0; //index of the last note of the span
+		const FragmentIndex* m_fragments = nullptr;
+
+		FailedStateTable m_failed;
+		std::vector<Worker> m_workers;
+		std::atomic<size_t> m_outstandingTasks = 0;
+		std::atomic<size_t> m_idleWorkers = 0;
+		std::atomic<bool> m_solved = false;
+		std::stop_token m_stop;
+		std::atomic<uint64_t> m_helperNodes = 0; //nodes expanded by the threads other than the caller's
+
+		std::mutex m_solutionMutex;
+		std::vector<SolutionStep> m_solution;
+
+		//marks the states of groups whose subtrees have all failed, walking up while that empties their parents
+		void release(std::shared_ptr<TaskGroup> group) {
+			while (group != nullptr && group->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				m_failed.insert(group->state);
+				group = group->parent;
+			}
+		}
+
+		void push(size_t workerIdx, SearchTask task) {
+			m_outstandingTasks.fetch_add(1, std::memory_order_relaxed);
+			std::lock_guard lock{ m_workers[workerIdx].mutex };
+			m_workers[workerIdx].tasks.push_back(std::move(task));
+		}
+
+		std::optional<SearchTask> pop(size_t workerIdx) {
+			{
+				std::lock_guard lock{ m_workers[workerIdx].mutex };
+				if (!m_workers[workerIdx].tasks.empty()) {
+					SearchTask task = std::move(m_workers[workerIdx].tasks.back());
+					m_workers[workerIdx].tasks.pop_back();
+					return task;
+				}
+			}
+			//steal the oldest, and so biggest, subtree of another worker
+			for (size_t i = 1; i < m_workers.size(); i++) {
+				Worker& victim = m_workers[(workerIdx + i) % m_workers.size()];
+				std::lock_guard lock{ victim.mutex };
+				if (!victim.tasks.empty()) {
+					SearchTask task = std::move(victim.tasks.front());
+					victim.tasks.pop_front();
+					return task;
+				}
+			}
+			return {};
+		}
+
+		//the moves out of node that follow the rules and can still reach the end, in a random order
+		std::vector<SearchNode> children(const SearchNode& node, std::mt19937& rng) const {
+			MSC_TRACE_NODE();
+			std::vector<SearchNode> ret;
+			size_t nextIdx = node.noteIdx + 1;
+			bool lastChord = nextIdx == m_goal;
+
+			forEachMove(*m_span.key, *node.chord, node.bass, m_soprano[node.noteIdx], m_soprano[nextIdx], nextIdx == m_soprano.size() - 1, 
+				        [&](const Chord& chord, const Note& bass) {
+				if (m_span.isLive(nextIdx, chord, bass.pitch) && (!lastChord || acceptsSpanEnd(m_span, m_endState, chord, bass.pitch))) {
+					ret.emplace_back(&chord, bass, nextIdx);
+				}
+			});
+
+			std::ranges::shuffle(ret, rng);
+			return ret;
+		}
+
+		//subtrees near the start are always split, and deeper ones are split off while someone has no work
+		bool shouldSplit(const SearchNode& node) const {
+			size_t depth = node.noteIdx - m_span.startIdx;
+			return depth <= SPLIT_DEPTH || (m_goal - node.noteIdx > SPLIT_DEPTH && m_idleWorkers.load(std::memory_order_relaxed) > 0);
+		}
+
+		Outcome search(size_t workerIdx, const SearchNode& node, std::vector<SolutionStep>& path, 
+			           std::shared_ptr<TaskGroup>& deferred, std::mt19937& rng) 
+		{
+			if (m_solved.load(std::memory_order_relaxed) || m_stop.stop_requested()) {
+				return Outcome::CANCELLED;
+			}
+			if (node.noteIdx == m_goal) {
+				std::lock_guard lock{ m_solutionMutex };
+				if (!m_solved.exchange(true)) {
+					m_solution = path;
+				}
+				return Outcome::SOLVED;
+			}
+			if (m_failed.contains(node.key())) {
+				return Outcome::FAILED;
+			}
+
+			std::shared_ptr<TaskGroup> group;
+			auto joinGroup = [&]() {
+				if (group == nullptr) {
+					group = std::make_shared<TaskGroup>(node.key());
+				}
+				group->pending.fetch_add(1, std::memory_order_relaxed);
+			};
+
+			//known fragments are followed first. Their ends are searched like children, and the single moves still follow
+			if (m_fragments != nullptr) {
+				auto acceptsEnd = [this](const Chord& chord, int pitch) { return acceptsSpanEnd(m_span, m_endState, chord, pitch); };
+				for (const auto& fragment : m_fragments->moves(*m_span.key, m_soprano, node.noteIdx, *node.chord, node.bass, m_goal, acceptsEnd)) {
+					const Chord& chord = m_span.key->chordOfId(fragment.back().chordId, fragment.back().inversion);
+					SearchNode end{ &chord, { chord.notes[chord.inversion].name, fragment.back().pitch }, node.noteIdx + fragment.size() };
+					if (!m_span.isLive(end.noteIdx, chord, end.bass.pitch)) {
+						continue;
+					}
+
+					path.insert(path.end(), fragment.begin(), fragment.end());
+					std::shared_ptr<TaskGroup> endGroup;
+					Outcome outcome = search(workerIdx, end, path, endGroup, rng);
+					path.resize(path.size() - fragment.size());
+
+					if (outcome == Outcome::SOLVED || outcome == Outcome::CANCELLED) {
+						return outcome;
+					} else if (outcome == Outcome::DEFERRED) {
+						joinGroup();
+						endGroup->parent = group;
+						release(endGroup);
+					}
+				}
+			}
+
+			for (const SearchNode& child : children(node, rng)) {
+				SolutionStep step{ static_cast<uint8_t>(child.chord->id), static_cast<uint8_t>(child.chord->inversion), 
+					               static_cast<uint8_t>(child.bass.pitch), 0, m_soprano[child.noteIdx].duration };
+				if (shouldSplit(child)) {
+					joinGroup();
+					std::vector<SolutionStep> childPath = path;
+					childPath.push_back(step);
+					push(workerIdx, { child, std::move(childPath), group });
+					continue;
+				}
+
+				path.push_back(step);
+				std::shared_ptr<TaskGroup> childGroup;
+				Outcome outcome = search(workerIdx, child, path, childGroup, rng);
+				path.pop_back();
+
+				if (outcome == Outcome::SOLVED || outcome == Outcome::CANCELLED) {
+					return outcome;
+				} else if (outcome == Outcome::DEFERRED) {
+					joinGroup();
+					childGroup->parent = group;
+					release(childGroup);
+				}
+			}
+
+			if (group == nullptr) {
+				m_failed.insert(node.key());
+				return Outcome::FAILED;
+			}
+			deferred = group; //the caller lets go of the search's share once it has linked the group
+			return Outcome::DEFERRED;
+		}
+
+		void work(size_t workerIdx) {
+			std::mt19937 rng{ std::random_device{}() };
+			uint64_t startNodes = expandedNodes;
+			while (!m_solved.load(std::memory_order_relaxed) && !m_stop.stop_requested() && 
+				   m_outstandingTasks.load(std::memory_order_acquire) > 0) 
+			{
+				auto task = pop(workerIdx);
+				if (!task.has_value()) {
+					m_idleWorkers.fetch_add(1, std::memory_order_relaxed);
+					std::this_thread::yield();
+					m_idleWorkers.fetch_sub(1, std::memory_order_relaxed);
+					continue;
+				}
+
+				std::shared_ptr<TaskGroup> group;
+				Outcome outcome = search(workerIdx, task->node, task->path, group, rng);
+				if (outcome == Outcome::FAILED) {
+					release(task->parent);
+				} else if (outcome == Outcome::DEFERRED) {
+					group->parent = task->parent; //the task's share of its parent passes to the group
+					release(group);
+				}
+				m_outstandingTasks.fetch_sub(1, std::memory_order_acq_rel);
+			}
+			if (workerIdx != 0) {
+				m_helperNodes.fetch_add(expandedNodes - startNodes, std::memory_order_relaxed);
+			}
+		}
+	public:
+		ParallelSearch(const KeySpan& span, std::span<const Note> soprano, std::optional<BassState> endState, size_t threadCount, 
+			           const FragmentIndex* fragments, std::stop_token stop)
+			: m_span(span), m_soprano(soprano), m_endState(std::move(endState)), m_goal(span.endIdx), m_fragments(fragments), 
+			  m_failed((span.endIdx - span.startIdx + 1) * 1024), m_workers(std::max<size_t>(threadCount, 1)), m_stop(std::move(stop)) {}
+
+		std::optional<std::vector<SolutionStep>> run(const SearchNode& start) {
+			push(0, { start, {}, nullptr });
+
+			std::vector<std::jthread> threads;
+			for (size_t i = 1; i < m_workers.size(); i++) {
+				threads.emplace_back(&ParallelSearch::work, this, i);
+			}
+			work(0);
+			threads.clear(); //joins
+			expandedNodes += m_helperNodes.load(std::memory_order_relaxed); //so the caller's span counts every worker's nodes
+
+			if (!m_solved) {
+				return {};
+			}
+			return std::move(m_solution);
+		}
+	};
+}
+
+std::optional<msc::OutputData> msc::solveSpanParallel(const KeySpan& span, std::span<const Note> sopranoLine, const Note& startBass, 
+	                                                   const Chord& startChord, std::optional<BassState> endState, size_t threadCount, 
+	                                                   const FragmentIndex* fragments, std::stop_token stop)
+{
+	MSC_TRACE_SPAN("parallel search");
+
+	ParallelSearch search{ span, sopranoLine, std::move(endState), threadCount, fragments, std::move(stop) };
+	auto steps = search.run({ &startChord, startBass, span.startIdx });
+	if (!steps.has_value()) {
+		return {};
+	}
+
+	OutputData data;
+	data.steps = std::move(steps.value());
+	data.keys = { span.key };
+	return data;
+}
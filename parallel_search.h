@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "bassline_maker.h"
+
+namespace msc {
+	/*a set of search states that have no path to the goal, shared by every thread without locks. 
+	It is open addressed, and once it fills up new states are dropped, since it is only a cache*/
+	class FailedStateTable {
+	private:
+		std::vector<std::atomic<uint64_t>> m_slots; //0 marks an empty slot
+		uint64_t m_mask = 0;
+
+		static constexpr size_t MAX_PROBES = 32;
+	public:
+		explicit FailedStateTable(size_t capacity); //rounded up to a power of 2
+
+		void insert(uint64_t state);
+		bool contains(uint64_t state) const;
+	};
+
+	inline constexpr size_t SPLIT_DEPTH = 4; //subtrees this close to the start of a span always become tasks
+
+	/*
+	* Harmonizes one span like solveSpan, with the search tree divided among threadCount threads.
+	* Shallow subtrees, and deeper ones whenever a thread is idle, become tasks on per thread deques. 
+	* Idle threads steal the oldest task of another thread. A state whose subtrees have all failed goes 
+	* into a FailedStateTable, so no thread explores it again. (note, chord, inversion, bass pitch) decides 
+	* every move after it, so a failed state fails no matter how it is reached.
+	* Unlike ChordTree, which takes the first legal octave of a bass note, every legal octave is tried. 
+	* Fragments of the index are followed before the single moves out of a state, like in ChordTree.
+	* Every thread stops once stop is requested, and nothing is returned.
+	*/
+	std::optional<OutputData> solveSpanParallel(const KeySpan& span, std::span<const Note> sopranoLine, const Note& startBass, 
+		                                        const Chord& startChord, std::optional<BassState> endState, size_t threadCount, 
+		                                        const FragmentIndex* fragments = nullptr, std::stop_token stop = {});
+}
@@ -1,7 +1,296 @@
 #include "parser.h"
 
-msc::ResultData msc::parseMeasures(std::string path) 
+std::shared_ptr<const msc::Key> msc::keyFromName(const std::string& keyName) {
+	//a key name is a letter, uppercase for major and lowercase for harmonic minor, followed by accidentals
+	bool validName = !keyName.empty() && pitches.contains(static_cast<char>(std::toupper(keyName[0]))) &&
+		             std::all_of(keyName.begin() + 1, keyName.end(), [&keyName](char chr) { return chr == keyName[1] && (chr == '#' || chr == 'b'); });
+	if (!validName) {
+		return nullptr;
+	}
+
+	Key::KeyQuality quality = Key::KeyQuality::MAJOR;
+
+	int pitchOfKey = pitches.at(std::toupper(keyName[0]));
+
+	if (keyName.size() > 1) { //if we have accidentals in key name, modify key pitch accordingly
+		int pitchMod = 0; //1 for sharp, -1 for flats
+		if (keyName[1] == 'b') {
+			pitchMod = -1;
+		} else {
+			pitchMod = 1;
+		}
+		pitchOfKey += (pitchMod * static_cast<int>(keyName.size() - 1));
+	}
+	if (std::islower(keyName[0])) { //make key harmonic minor if the first character is lowercase
+		quality = Key::KeyQuality::HARMONIC_MINOR;
+	}
+
+	return sharedKey(quality, { std::string { static_cast<char>(std::toupper(keyName[0])) }, pitchOfKey });
+}
+
+std::optional<msc::HarmonyLabel> msc::parseHarmony(StringVecIt& harmonyIt, StringVecIt endIt) {
+	HarmonyLabel label;
+	int functionCount = 0; //secondary dominants are written as two functions, V/vi as V then vi
+	std::string functionName;
+
+	for (; harmonyIt != endIt && *harmonyIt != "</harmony>"; harmonyIt++) {
+		if (harmonyIt->contains("<function>")) {
+			functionName += (functionCount > 0 ? "/" : "") + enclosedString(*harmonyIt, '>', '<');
+			functionCount++;
+		} else if (harmonyIt->contains("<inversion>")) {
+			label.inversion = std::stoi(enclosedString(*harmonyIt, '>', '<'));
+		}
+	}
+
+	if (functionCount == 0) {
+		return {};
+	}
+	if (!numeralsToDegrees.contains(functionName)) {
+		std::cout << "Warning: " << functionName << " is not a chord of the vocabulary, so its label is skipped\n";
+		return {};
+	}
+	label.degree = numeralsToDegrees.at(functionName);
+
+	return label;
+}
+
+/*
+* For each note attribute section, parse the following lines in order: 
+* 1. The name (A, B, C, etc) from the step attribute. 
+* 2. The octave from the octave attribute. Add the pitch of current note by 8 * octave
+* 3. The duration attribute, measured in divisions of a quarter note
+* 4. A tie stop, which lengthens the previous note instead of starting a new one
+* Harmony labels and words are collected along the way if annotations is given.
+* Grace notes and the lower notes of chords do not take up time, so they are skipped.
+* Rests and the gaps left by <forward> are held as silence on the note before them (or the first note, 
+* if they come before it), so every note starts at its onset in the score. Rests after the last note are left 
+* out, since that is where the bassline gets written. Notes that start before the notes already read have 
+* ended, the other voices after a <backup>, are skipped.
+*/
+std::vector<msc::Note> msc::parsePartData(StringVecIt partIt, StringVecIt partEnd, int& divisions, 
+	                                        PartAnnotations* annotations) 
+{
+	MSC_TRACE_SPAN("parse part");
+
+	std::vector<Note> notes;
+
+	divisions = 0;
+	int scale = 1; //factor from the divisions of the current measure to the divisions of the part
+	int onset = 0; //where the next note of the part starts
+	int end = 0;   //where the notes read so far end
+	int leadingSilence = 0; //rests before the first note
+
+	//a gap between the notes read so far and the next one is held on the last of them
+	auto holdSilence = [&] {
+		if (onset <= end) {
+			return;
+		}
+		(notes.empty() ? leadingSilence : notes.back().duration) += onset - end;
+		end = onset;
+	};
+
+	while (true) {
+		skipToAnyLine(partIt, partEnd, { "<step>", "<rest", "<backup>", "<forward>", "<divisions>", "<harmony", "<words>" });
+		if (partIt == partEnd) {
+			break;
+		}
+
+		if (partIt->contains("<backup>") || partIt->contains("<forward>")) {
+			int sign = partIt->contains("<backup>") ? -1 : 1;
+			skipToLine(partIt, partEnd, "<duration>", 1);
+			if (partIt == partEnd) {
+				break;
+			}
+			onset += sign * std::stoi(enclosedString(*partIt, '>', '<')) * scale;
+			partIt++;
+			continue;
+		}
+
+		//harmony labels and words belong to the note that follows them
+		if (partIt->contains("<harmony")) {
+			auto label = parseHarmony(partIt, partEnd);
+			if (annotations != nullptr && label.has_value()) {
+				label->noteIdx = notes.size();
+				annotations->harmonies.push_back(label.value());
+			}
+			continue;
+		}
+		if (partIt->contains("<words>")) {
+			if (annotations != nullptr) {
+				annotations->words.emplace_back(notes.size(), enclosedString(*partIt, '>', '<'));
+			}
+			partIt++;
+			continue;
+		}
+
+		/*a part may change its divisions midway. To keep every duration exact, measure the 
+		whole part in the least common multiple of all its divisions*/
+		if (partIt->contains("<divisions>")) {
+			int newDivisions = std::stoi(enclosedString(*partIt, '>', '<'));
+			if (divisions == 0) {
+				divisions = newDivisions;
+			}
+			int commonDivisions = std::lcm(divisions, newDivisions);
+			for (Note& note : notes) {
+				note.duration *= commonDivisions / divisions;
+			}
+			onset *= commonDivisions / divisions;
+			end *= commonDivisions / divisions;
+			leadingSilence *= commonDivisions / divisions;
+			scale = commonDivisions / newDivisions;
+			divisions = commonDivisions;
+			partIt++;
+			continue;
+		}
+
+		//look back to the start of the note for grace and chord flags
+		bool skipNote = false;
+		for (auto flagIt = partIt; !flagIt->starts_with("<note"); flagIt--) {
+			if (flagIt->contains("<grace") || flagIt->contains("<chord/>")) {
+				skipNote = true;
+			}
+		}
+		if (skipNote) {
+			partIt++;
+			continue;
+		}
+
+		if (partIt->contains("<rest")) {
+			skipToLine(partIt, partEnd, "<duration>", 1);
+			if (partIt == partEnd) {
+				break;
+			}
+			onset += std::stoi(enclosedString(*partIt, '>', '<')) * scale;
+			partIt++;
+			continue;
+		}
+
+		std::string name;
+		name.push_back(enclosedString(*partIt, '>', '<').at(0));
+		int pitch = pitches.at(name[0]);
+
+		skipToEitherLine(partIt, partEnd, "alter", "octave");
+		if (partIt->contains("alter")) {
+			int pitchAlteration = std::stoi(enclosedString(*partIt, '>', '<')); //1 for sharp and -1 for flat
+			pitch += pitchAlteration;
+
+			char accidental = 'b';
+			if (pitchAlteration >= 1) {
+				accidental = '#';
+			}
+			for (int i = 0; i < std::abs(pitchAlteration); i++) {
+				name.push_back(accidental);
+			}
+			skipToLine(partIt, partEnd, "octave", 1);
+			auto enString = enclosedString(*partIt, '>', '<');
+			int octave = std::stoi(enclosedString(*partIt, '>', '<'));
+			if (pitch + (12 * octave) < 0) {
+				std::cout << "Iterator: " << *partIt << std::endl;
+				std::cout << "Enclosed String: " << enString << std::endl;
+				std::cout << "Pitch: " << pitch << std::endl;
+				std::cout << "Octave: " << octave << std::endl;
+			}
+			pitch += (12 * octave);
+			//std::cout << "Altered pitch: " << pitch << std::endl;
+		} else { //if *partIt->contains("octave")
+			int octave = std::stoi(enclosedString(*partIt, '>', '<'));
+			if (pitch + (12 * octave) < 0) {
+				std::cout << "Pitch: " << pitch << std::endl;
+				std::cout << "Octave: " << octave << std::endl;
+			}
+			pitch += (12 * octave);
+			//std::cout << "Altered pitch: " << pitch << std::endl;
+		}
+		skipToLine(partIt, partEnd, "<duration>", 1);
+		int duration = std::stoi(enclosedString(*partIt, '>', '<')) * scale;
+
+		//a tied note continues the previous note rather than sounding a new one
+		bool tieStop = false;
+		for (; partIt != partEnd && *partIt != "</note>"; partIt++) {
+			if (partIt->contains("<tietype=\"stop\"")) {
+				tieStop = true;
+			}
+		}
+
+		if (onset < end) { //another voice
+			onset += duration;
+			continue;
+		}
+		holdSilence();
+		if (tieStop && !notes.empty() && notes.back().pitch == pitch) {
+			notes.back().duration += duration;
+		} else {
+			notes.emplace_back(name, pitch, duration + (notes.empty() ? leadingSilence : 0));
+		}
+		onset += duration;
+		end = onset;
+
+		//std::cout << "Parsed: " << duration << std::endl;
+	}
+
+	if (divisions == 0) {
+		divisions = 1;
+	}
+
+	return notes;
+}
+
+std::vector<msc::PartInfo> msc::listParts(const StringVec& lines) {
+	std::vector<PartInfo> parts;
+
+	auto it = std::find_if(lines.begin(), lines.end(), [](const std::string& line) { return line.contains("<part-list>"); });
+	for (; it != lines.end() && !it->contains("</part-list>"); it++) {
+		std::string line = withoutWhitespace(*it);
+		if (line.contains("<score-partid=")) {
+			parts.push_back({ enclosedString(line, '"', '"'), "" });
+		} else if (line.contains("<part-name") && !parts.empty()) {
+			parts.back().name = enclosedString(line, '>', '<');
+		}
+	}
+
+	return parts;
+}
+
+std::optional<msc::PartInfo> msc::selectPart(const std::vector<PartInfo>& parts, std::string idOrName, size_t defaultIdx) {
+	if (idOrName.empty()) {
+		if (defaultIdx >= parts.size()) {
+			return {};
+		}
+		return parts[defaultIdx];
+	}
+
+	//names are compared without whitespace because listParts strips it
+	idOrName = withoutWhitespace(std::move(idOrName));
+
+	auto partIt = std::find_if(parts.begin(), parts.end(), 
+		[&](const PartInfo& part) { return part.id == idOrName || part.name == idOrName; }
+	);
+	if (partIt == parts.end()) {
+		return {};
+	}
+	return *partIt;
+}
+
+//returns the lines between <part id="partId"> and its closing </part>
+std::optional<std::pair<msc::StringVecIt, msc::StringVecIt>> msc::partRange(StringVec& lines, const std::string& partId) {
+	std::string partTag = "<partid=\"" + partId + "\">";
+
+	auto partBegin = std::find_if(lines.begin(), lines.end(), 
+		[&partTag](const std::string& line) { return line.contains("<part") && withoutWhitespace(line) == partTag; }
+	);
+	if (partBegin == lines.end()) {
+		return {};
+	}
+	auto partEnd = partBegin;
+	skipToLine(partEnd, lines.end(), "</part>", 1);
+
+	return std::make_pair(partBegin, partEnd);
+}
+
+msc::ResultData msc::parseMeasures(std::string path, const PartSelection& selection) 
 {
+	MSC_TRACE_SPAN("parse");
+
 	std::ifstream file;
 	file.open(path);
 
@@ -19,156 +308,107 @@ msc::ResultData msc::parseMeasures(std::string path)
 	}
 	file.close(); //we are done using the input file
 
-	//erase all whitespace from the beginning of each line. 
-	for (auto& line : lines) {
-		line.erase(std::remove_if(line.begin(), line.end(), std::isspace), line.end());
-	}
-
-	StringVecIt linesIt = lines.begin(); 
-
-	auto loadPartData = [linesIt](StringVec& data) mutable {
-		while (true) {
-			data.push_back(*linesIt);
-			if (linesIt->contains("</part>")) {
-				linesIt ++;
-				break;
-			}
-			linesIt++;
-		}
-	};
-
-	std::string keyName; //name of the key
-	int pitchOfKey = 0;
+	std::string keyName; //name of the opening key
 	auto keyNameIt = std::find_if(lines.begin(), lines.end(),
 		[](const std::string& line) { return line.contains("<words>"); }
 	);
 	if (keyNameIt == lines.end()) {
-		std::cout << "Error: no key was provided! Go back to your score in flat, hit the text tab, then hit annotation,\n";
-		std::cout << "and then write the name of the key, uppercase for major and lowercase for harmonic minor.\n";
-		std::cout << "Ex: C#  = C# major, d = d harmonic minor.\n";
+		std::cout << "No key was provided, so it will be guessed from the soprano. To give it, go back to your score in flat,\n";
+		std::cout << "hit the text tab, then hit annotation, and then write the name of the key, uppercase for major and\n";
+		std::cout << "lowercase for harmonic minor. Ex: C#  = C# major, d = d harmonic minor.\n";
+	} else {
+		keyName = withoutWhitespace(enclosedString(*keyNameIt, '>', '<'));
+	}
+
+	auto parts = listParts(lines);
+	auto sopranoPart = selectPart(parts, selection.soprano, 0);
+	auto bassPart = selectPart(parts, selection.bass, 1);
+	if (!sopranoPart.has_value() || !bassPart.has_value()) {
+		std::cout << "Error: could not find the soprano and bass parts. The score has these parts:\n";
+		for (const PartInfo& part : parts) {
+			std::cout << part.id << " (" << part.name << ")\n";
+		}
 		return {};
 	}
-	keyName = enclosedString(*keyNameIt, '>', '<');
 
-	auto finalChordNameIt = std::find_if(lines.begin(), lines.end(),
-		[](const std::string& line) { return line.contains("<function>"); }
-	);
-	if (finalChordNameIt == lines.end()) {
-		std::cout << "Error: you need to write the final chord before the bassline ends\n";
-		exit(0);
+	//locate the <part> sections of the soprano and bass, skipping every other part without parsing it
+	auto sopranoRange = partRange(lines, sopranoPart->id);
+	auto bassRange = partRange(lines, bassPart->id);
+	if (!sopranoRange.has_value() || !bassRange.has_value()) {
+		std::cout << "Error: the selected parts have no notes\n";
+		return {};
 	}
 
-	std::string finalStringName = enclosedString(*finalChordNameIt, '>', '<');
-	for (const char& chr : *finalChordNameIt) {
-		if (isalpha(chr)) {
-			finalStringName.push_back(chr);
-		} else {
-			break;
+	//only the two parts are parsed line by line, so only their whitespace is erased
+	for (auto range : { sopranoRange.value(), bassRange.value() }) {
+		for (auto it = range.first; it != range.second; it++) {
+			*it = withoutWhitespace(std::move(*it));
 		}
 	}
-	std::cout << "Final string name: " << finalStringName << std::endl;
-	int finalDegree = numeralsToDegrees.at(finalStringName);
-	std::cout << "Parsed this degree: " << finalDegree << std::endl;
 
-	Key::KeyQuality quality = Key::KeyQuality::MAJOR;
+	//the parts share no state, so parse them concurrently
+	int sopranoDivisions = 0, bassDivisions = 0;
+	PartAnnotations sopranoAnnotations, bassAnnotations;
+	auto sopranoFuture = std::async(std::launch::async, parsePartData, sopranoRange->first, sopranoRange->second, 
+		                            std::ref(sopranoDivisions), &sopranoAnnotations);
+	auto bass = parsePartData(bassRange->first, bassRange->second, bassDivisions, &bassAnnotations);
+	auto soprano = sopranoFuture.get();
 
-	pitchOfKey = pitches.at(std::toupper(keyName[0]));
+	//labels in the soprano are waypoints, so the chord the given bassline ends on is its own last label
+	int finalDegree = 1;
+	if (!bassAnnotations.harmonies.empty()) {
+		finalDegree = bassAnnotations.harmonies.back().degree;
+	} else if (!bass.empty()) {
+		std::cout << "Error: you need to write the final chord before the bassline ends\n";
+		return {};
+	}
 
-	if (keyName.size() > 1) { //if we have accidentals in key name, modify key pitch accordingly
-		int pitchMod = 0; //1 for sharp, -1 for flats
-		if (keyName[1] == 'b') {
-			pitchMod = -1;
+	/*key annotations in the soprano part start a new key segment at the following note. If the opening 
+	key is written somewhere else, it covers the soprano until the first annotation*/
+	std::vector<KeySegment> keys;
+	for (const auto& [noteIdx, words] : sopranoAnnotations.words) {
+		auto key = keyFromName(words);
+		if (key == nullptr) {
+			continue;
+		}
+		if (!keys.empty() && keys.back().noteIdx == noteIdx) {
+			keys.back().key = key;
 		} else {
-			pitchMod = 1;
+			keys.emplace_back(noteIdx, key);
 		}
-		pitchOfKey += (pitchMod * static_cast<int>(keyName.size() - 1));
 	}
-	if (std::islower(keyName[0])) { //make key harmonic minor if the first character is lowercase
-		quality = Key::KeyQuality::HARMONIC_MINOR;
+	if (!keyName.empty() && (keys.empty() || keys.front().noteIdx != 0)) {
+		//the first words can be a direction like "dolce" rather than a key, and then the key is found some other way
+		auto openingKey = keyFromName(keyName);
+		if (openingKey != nullptr) {
+			keys.insert(keys.begin(), { 0, openingKey });
+		} else if (keys.empty()) {
+			std::cout << "Warning: " << keyName << " is not the name of a key, so the key will be guessed from the soprano\n";
+		} else {
+			std::cout << "Warning: " << keyName << " is not the name of a key, so the soprano starts in " 
+				      << keys.front().key->tonic().name << (keys.front().key->major ? " major" : " harmonic minor") << "\n";
+			keys.front().noteIdx = 0;
+		}
 	}
 
-	Key key{ quality, { std::string { static_cast<char>(std::toupper(keyName[0])) }, pitchOfKey } };
-
-	std::vector<Note> bass, tenor, alto, soprano;
-
-	skipToLine(linesIt, lines.end(), "<partid", 1);
-
-	/*
-	* For each note attribute section, parse the following lines in order: 
-	* 1. The name (A, B, C, etc) from the step attribute. 
-	* 2. The octave from the octave attribute. Add the pitch of current note by 8 * octave
-	* 3. The type of note (quarter, eighth, etc) which will affect its duration
-	*/
-	auto parsePartData = [&](std::vector<Note>& notes) {
-		StringVec partData;
-		loadPartData(partData);
-
-		auto partIt = partData.begin();
-
-		while (true) {
-			skipToLine(partIt, partData.end(), "<step>", 1);
-			if (partIt == partData.end()) {
-				break;
-			}
-
-			std::string name;
-			name.push_back(enclosedString(*partIt, '>', '<').at(0));
-			int pitch = pitches.at(name[0]);
-
-			skipToEitherLine(partIt, partData.end(), "alter", "octave");
-			if (partIt->contains("alter")) {
-				int pitchAlteration = std::stoi(enclosedString(*partIt, '>', '<')); //1 for sharp and -1 for flat
-				pitch += pitchAlteration;
-
-				char accidental = 'b';
-				if (pitchAlteration >= 1) {
-					accidental = '#';
-				}
-				for (int i = 0; i < std::abs(pitchAlteration); i++) {
-					name.push_back(accidental);
-				}
-				skipToLine(partIt, partData.end(), "octave", 1);
-				auto enString = enclosedString(*partIt, '>', '<');
-				int octave = std::stoi(enclosedString(*partIt, '>', '<'));
-				if (pitch + (12 * octave) < 0) {
-					std::cout << "Iterator: " << *partIt << std::endl;
-					std::cout << "Enclosed String: " << enString << std::endl;
-					std::cout << "Pitch: " << pitch << std::endl;
-					std::cout << "Octave: " << octave << std::endl;
-				}
-				pitch += (12 * octave);
-				//std::cout << "Altered pitch: " << pitch << std::endl;
-			} else { //if *partIt->contains("octave")
-				int octave = std::stoi(enclosedString(*partIt, '>', '<'));
-				if (pitch + (12 * octave) < 0) {
-					std::cout << "Pitch: " << pitch << std::endl;
-					std::cout << "Octave: " << octave << std::endl;
-				}
-				pitch += (12 * octave);
-				//std::cout << "Altered pitch: " << pitch << std::endl;
-			}
-			skipToLine(partIt, partData.end(), "<type>", 1);
-			std::string type = enclosedString(*partIt, '>', '<');
-
-			int duration = 0;
-
-			if (type == "eighth") {
-				duration = 2;
-			} else if (type == "quarter") {
-				duration = 4;
-			} else if (type == "half") {
-				duration = 8;
-			} else if (type == "whole") {
-				duration = 16;
-			}
-			notes.emplace_back(name, pitch, duration);
-
-			//std::cout << "Parsed: " << duration << std::endl;
-		} 
-	}; 
+	//measure both parts in the same unit
+	Meter meter;
+	meter.divisions = std::lcm(sopranoDivisions, bassDivisions);
+	for (Note& note : soprano) {
+		note.duration *= meter.divisions / sopranoDivisions;
+	}
+	for (Note& note : bass) {
+		note.duration *= meter.divisions / bassDivisions;
+	}
 
-	parsePartData(soprano);
-	parsePartData(bass);
+	auto beatsIt = std::find_if(lines.begin(), lines.end(), [](const std::string& line) { return line.contains("<beats>"); });
+	if (beatsIt != lines.end()) {
+		meter.beats = std::stoi(enclosedString(*beatsIt, '>', '<'));
+		skipToLine(beatsIt, lines.end(), "<beat-type>", 1);
+		if (beatsIt != lines.end()) {
+			meter.beatType = std::stoi(enclosedString(*beatsIt, '>', '<'));
+		}
+	}
 
 	/*std::cout << "Soprano Line: \n";
 	for (Note& note : soprano) {
@@ -186,5 +426,6 @@ msc::ResultData msc::parseMeasures(std::string path)
 		std::cout << std::endl;
 	}*/
 
-	return make_tuple(key, soprano, bass, finalDegree);
+	return ScoreData{ std::move(keys), std::move(soprano), std::move(bass), finalDegree, bassPart->id, meter, 
+		              std::move(bassAnnotations.harmonies), std::move(sopranoAnnotations.harmonies) };
 }
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include <iostream>
 #include <optional>
 #include <tuple>
+#include <future>
+#include <numeric>
 
 #include "types.h"
 #include "file_util.h"
@@ -12,16 +14,82 @@
 namespace msc {
 	inline std::map<std::string, int> numeralsToDegrees{
 		{ "I", 1 },
+		{ "i", 1 },
 		{ "ii", 2 },
+		{ "iii", 3 },
+		{ "III", 3 },
 		{ "IV", 4 },
 		{ "iv", 4 },
 		{ "V", 5 },
 		{ "v", 5 },
 		{ "VI", 6 },
 		{ "vi", 6 },
+		{ "vii", 7 },
+		{ "V/V", SECONDARY_DOM_DEGREE },
+		{ "V/vi", SECONDARY_DOM_OF_SIX_DEGREE },
+		{ "V/VI", SECONDARY_DOM_OF_SIX_DEGREE },
+		{ "V/IV", SECONDARY_DOM_OF_FOUR_DEGREE },
+		{ "V/iv", SECONDARY_DOM_OF_FOUR_DEGREE },
+		{ "viio7", DIMINISHED_SEVENTH_DEGREE },
+		{ "N", NEAPOLITAN_DEGREE },
+		{ "It+6", ITALIAN_SIXTH_DEGREE },
+		{ "Fr+6", FRENCH_SIXTH_DEGREE },
+		{ "Ger+6", GERMAN_SIXTH_DEGREE }
 	};
 
-	//Data contains a key (e.g. D major), the soprano line, the bassline, the degree of the last written chord
-	using ResultData = std::optional<std::tuple<Key, std::vector<Note>, std::vector<Note>, int>>;
-	ResultData parseMeasures(std::string path);
+
+	//a part declared in the <part-list> of a score
+	struct PartInfo {
+		std::string id;   //e.g. P1
+		std::string name; //e.g. Soprano, without whitespace
+	};
+
+	//ids or names of the parts to harmonize. Empty strings select the first and second declared parts
+	struct PartSelection {
+		std::string soprano;
+		std::string bass;
+	};
+
+	//harmony labels and words written in a part, indexed by the note that follows them
+	struct PartAnnotations {
+		std::vector<HarmonyLabel> harmonies;
+		std::vector<std::pair<size_t, std::string>> words;
+	};
+
+	//Data contains the keys (e.g. D major) of each segment of the soprano, the soprano line, the bassline, 
+	//the degree of the last written chord, the id of the part the bassline belongs to and the meter both 
+	//lines are measured in
+	struct ScoreData {
+		std::vector<KeySegment> keys; //starts with the opening key. Empty if the score doesn't name one (see rankKeys)
+		std::vector<Note> soprano;
+		std::vector<Note> bass;
+		int finalDegree = 0;
+		std::string bassPartId;
+		Meter meter;
+		std::vector<HarmonyLabel> harmonies;        //chord labels of the bass part
+		std::vector<HarmonyLabel> waypoints; //chord labels at soprano indices, which the written bassline has to pass through
+	};
+	using ResultData = std::optional<ScoreData>;
+
+	//returns the parts declared in the <part-list> of the score, in order
+	std::vector<PartInfo> listParts(const StringVec& lines);
+
+	//finds a part by id or name. If idOrName is empty, the part at defaultIdx is selected
+	std::optional<PartInfo> selectPart(const std::vector<PartInfo>& parts, std::string idOrName, size_t defaultIdx);
+
+	//returns the lines between <part id="partId"> and its closing </part>
+	std::optional<std::pair<StringVecIt, StringVecIt>> partRange(StringVec& lines, const std::string& partId);
+
+	//returns the shared key named like "C#" (C# major) or "d" (d harmonic minor), or nullptr for other words
+	std::shared_ptr<const Key> keyFromName(const std::string& keyName);
+
+	//parses a <harmony> element, leaving harmonyIt at its closing line
+	std::optional<HarmonyLabel> parseHarmony(StringVecIt& harmonyIt, StringVecIt endIt);
+
+	/*parses every note in the lines of a single part. Durations are measured in the returned divisions.
+	If annotations is not null, the part's harmony labels and words are added to it*/
+	std::vector<Note> parsePartData(StringVecIt partIt, StringVecIt partEnd, int& divisions, 
+		                            PartAnnotations* annotations = nullptr);
+
+	ResultData parseMeasures(std::string path, const PartSelection& selection = {});
 }
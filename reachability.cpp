@@ -0,0 +1,225 @@
+#include "reachability.h"
+
+namespace {
+	using namespace msc;
+
+	//calls visit with every chord of key, in each inversion, over each in range octave of its bass note
+	template<typename Visit>
+	void forEachState(const Key& key, Visit&& visit) {
+		for (size_t id = 0; id < key.chordCount(); id++) {
+			for (size_t inversion = 0; inversion < key.chordOfId(id).notes.size(); inversion++) {
+				const Chord& chord = key.chordOfId(id, static_cast<int>(inversion));
+				Note bass = chord.notes[inversion];
+				for (bass.pitch = LOWEST_BASS_PITCH + (pitchClass(bass) - LOWEST_BASS_PITCH % 12 + 12) % 12; 
+					 bass.pitch <= HIGHEST_BASS_PITCH; bass.pitch += 12) 
+				{
+					visit(chord, bass);
+				}
+			}
+		}
+	}
+
+	//the chord a span ends on, as the next span starts from it
+	Chord carriedChord(const KeySpan& span, const Chord& chord) {
+		if (span.nextKey == nullptr) {
+			return chord;
+		}
+		Chord pivot = *span.nextKey->pivotChord(chord);
+		pivot.inversion = chord.inversion;
+		return pivot;
+	}
+}
+
+bool msc::findLiveStates(BassLinePlan& plan) {
+	MSC_TRACE_SPAN("live states");
+
+	std::span<const Note> soprano = plan.harmonizedLine();
+	std::shared_ptr<const std::vector<StateSet>> nextLiveStates; //of the span after the current one
+
+	for (size_t i = plan.spans.size(); i-- > 0;) {
+		KeySpan& span = plan.spans[i];
+		const Key& key = *span.key;
+		auto liveStates = std::make_shared<std::vector<StateSet>>(span.endIdx - span.startIdx + 1);
+		std::vector<StateSet>& states = *liveStates;
+
+		//the last note has to end the span, and the next span has to go on from it
+		forEachState(key, [&](const Chord& chord, const Note& bass) {
+			if (!acceptsSpanEnd(span, plan.pins[i], chord, bass.pitch)) {
+				return;
+			}
+			if (nextLiveStates != nullptr && !nextLiveStates->front().test(stateIndex(carriedChord(span, chord), bass.pitch))) {
+				return;
+			}
+			states.back().set(stateIndex(chord, bass.pitch));
+		});
+
+		//a state before it is live if one of its moves is
+		for (size_t noteIdx = span.endIdx; noteIdx-- > span.startIdx;) {
+			const StateSet& nextStates = states[noteIdx + 1 - span.startIdx];
+			bool finalChord = noteIdx + 1 == soprano.size() - 1;
+			forEachState(key, [&](const Chord& chord, const Note& bass) {
+				bool live = false;
+				forEachMove(key, chord, bass, soprano[noteIdx], soprano[noteIdx + 1], finalChord, [&](const Chord& next, const Note& nextBass) {
+					live = live || nextStates.test(stateIndex(next, nextBass.pitch));
+				});
+				if (live) {
+					states[noteIdx - span.startIdx].set(stateIndex(chord, bass.pitch));
+				}
+			});
+		}
+
+		span.liveStates = liveStates;
+		nextLiveStates = std::move(liveStates);
+	}
+
+	//the start state may not be an in range state of the key, so its moves are checked instead
+	const KeySpan& first = plan.spans.front();
+	bool live = false;
+	forEachMove(*first.key, plan.start.chord, plan.start.bass, soprano[first.startIdx], soprano[first.startIdx + 1], 
+		        first.startIdx + 1 == soprano.size() - 1, [&](const Chord& next, const Note& nextBass) {
+		live = live || first.isLive(first.startIdx + 1, next, nextBass.pitch);
+	});
+	return live;
+}
+
+bool msc::pinWaypoints(BassLinePlan& plan) {
+	if (plan.spans.empty() || (plan.spans.front().liveStates == nullptr && !findLiveStates(plan))) {
+		return false;
+	}
+
+	MSC_TRACE_SPAN("pin waypoints");
+	static thread_local std::mt19937 rng{ std::random_device{}() };
+	std::span<const Note> soprano = plan.harmonizedLine();
+
+	//walk forward through the live states, keeping every state that the start can reach
+	std::vector<BassState> frontier{ plan.start };
+	for (size_t i = 0; i < plan.spans.size(); i++) {
+		const KeySpan& span = plan.spans[i];
+		for (size_t noteIdx = span.startIdx; noteIdx < span.endIdx; noteIdx++) {
+			StateSet reached;
+			std::vector<BassState> next;
+			for (const BassState& state : frontier) {
+				forEachMove(*span.key, state.chord, state.bass, soprano[noteIdx], soprano[noteIdx + 1], noteIdx + 1 == soprano.size() - 1, 
+					        [&](const Chord& chord, const Note& bass) {
+					size_t stateIdx = stateIndex(chord, bass.pitch);
+					if (span.isLive(noteIdx + 1, chord, bass.pitch) && !reached.test(stateIdx)) {
+						reached.set(stateIdx);
+						next.emplace_back(chord, bass);
+					}
+				});
+			}
+			frontier = std::move(next);
+		}
+		if (frontier.empty()) {
+			return false;
+		}
+
+		//any of the states reached at a waypoint has a path on to the end
+		if (span.waypoint.has_value() && i + 1 < plan.spans.size() && !plan.pins[i].has_value()) {
+			std::uniform_int_distribution<size_t> dist(0, frontier.size() - 1);
+			plan.pins[i] = frontier[dist(rng)];
+			frontier = { plan.pins[i].value() };
+		}
+		for (BassState& state : frontier) {
+			state.chord = carriedChord(span, state.chord);
+		}
+	}
+
+	return !frontier.empty();
+}
+
+std::optional<msc::Conflict> msc::findConflict(BassLinePlan& plan) {
+	if (plan.spans.empty() || findLiveStates(plan)) {
+		return {};
+	}
+
+	MSC_TRACE_SPAN("conflict");
+	std::span<const Note> soprano = plan.harmonizedLine();
+	Conflict conflict;
+
+	//a note with no live states leaves every note before it without any too, so the latest one is the first found
+	for (size_t i = plan.spans.size(); i-- > 0 && !conflict.deadIdx.has_value();) {
+		const KeySpan& span = plan.spans[i];
+		for (size_t noteIdx = span.endIdx; noteIdx > span.startIdx; noteIdx--) {
+			if ((*span.liveStates)[noteIdx - span.startIdx].none()) {
+				conflict.deadIdx = noteIdx;
+				break;
+			}
+		}
+	}
+
+	//walk forward from the start until the reachable states run out
+	std::vector<BassState> frontier{ plan.start };
+	for (size_t i = 0; i < plan.spans.size(); i++) {
+		const KeySpan& span = plan.spans[i];
+		const Key& key = *span.key;
+		for (size_t noteIdx = span.startIdx; noteIdx < span.endIdx; noteIdx++) {
+			const Note& nextSoprano = soprano[noteIdx + 1];
+			bool finalChord = noteIdx + 1 == soprano.size() - 1;
+			StateSet reached;
+			std::vector<BassState> next;
+			for (const BassState& state : frontier) {
+				forEachMove(key, state.chord, state.bass, soprano[noteIdx], nextSoprano, finalChord, [&](const Chord& chord, const Note& bass) {
+					size_t stateIdx = stateIndex(chord, bass.pitch);
+					if (!reached.test(stateIdx)) {
+						reached.set(stateIdx);
+						next.emplace_back(chord, bass);
+					}
+				});
+			}
+
+			if (next.empty()) {
+				//every move into the note broke a rule. Chords without the soprano note were never an option
+				conflict.noteIdx = noteIdx + 1;
+				for (const BassState& state : frontier) {
+					forEachState(key, [&](const Chord& chord, const Note& bass) {
+						bool hasSoprano = std::ranges::any_of(chord.notes, [&](const Note& note) { return pitchClass(note) == pitchClass(nextSoprano); });
+						auto rule = hasSoprano ? moveViolation(key, state.chord, state.bass, soprano[noteIdx], nextSoprano, finalChord, chord, bass) 
+							                   : std::nullopt;
+						if (rule.has_value()) {
+							conflict.rules[rule.value()]++;
+						}
+					});
+				}
+				return conflict;
+			}
+			frontier = std::move(next);
+		}
+
+		//the span has to end on its waypoint and pivot into the next key
+		size_t endStates = frontier.size();
+		std::erase_if(frontier, [&](const BassState& state) { return !acceptsSpanEnd(span, plan.pins[i], state.chord, state.bass.pitch); });
+		if (frontier.empty()) {
+			conflict.noteIdx = span.endIdx;
+			conflict.spanEnds = endStates;
+			return conflict;
+		}
+		for (BassState& state : frontier) {
+			state.chord = carriedChord(span, state.chord);
+		}
+	}
+
+	//the start had no live moves even though the sweep got through, which only an out of range start can do
+	conflict.noteIdx = plan.spans.front().startIdx + 1;
+	return conflict;
+}
+
+void msc::printConflict(const Conflict& conflict, std::span<const Note> harmonizedLine) {
+	const Note& note = harmonizedLine[conflict.noteIdx];
+	std::cout << "Error: no bassline that follows the rules reaches note " << conflict.noteIdx << " (" << note.name << ") of the soprano";
+	if (conflict.deadIdx.has_value()) {
+		std::cout << ", and nothing from note " << conflict.deadIdx.value() << " on can reach the end";
+	}
+	std::cout << "\n";
+
+	if (conflict.spanEnds > 0) {
+		std::cout << conflict.spanEnds << " states reach it, but none of them fits its chord label or pivots into the next key\n";
+	}
+
+	//the rules that ruled out the most moves first
+	std::vector<std::pair<Rule, size_t>> rules{ conflict.rules.begin(), conflict.rules.end() };
+	std::ranges::stable_sort(rules, std::ranges::greater{}, &std::pair<Rule, size_t>::second);
+	for (const auto& [rule, moves] : rules) {
+		std::cout << "  " << ruleName(rule) << ": " << moves << (moves == 1 ? " move\n" : " moves\n");
+	}
+}
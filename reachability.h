@@ -0,0 +1,33 @@
+#pragma once
+
+#include <map>
+
+#include "bassline_maker.h"
+
+namespace msc {
+	/*works out the live states of each span of the plan: the states that have a path to the end of the bassline 
+	that follows the rules and passes through every waypoint and pin. It works backwards from the end, one note 
+	at a time. Returns false if the start of the plan has no such path*/
+	bool findLiveStates(BassLinePlan& plan);
+
+	/*pins the state at every waypoint to a live state, picked at random along a path from the start, so each 
+	span between waypoints can be solved on its own. Works out the live states first, unless they already are. 
+	Returns false if there is no bassline through the waypoints*/
+	bool pinWaypoints(BassLinePlan& plan);
+
+	//where and why a plan has no bassline
+	struct Conflict {
+		size_t noteIdx = 0; //earliest note of the harmonized soprano that no partial bassline from the start reaches
+		std::optional<size_t> deadIdx; //latest note with no state that has a path to the end, if there is one
+		std::map<Rule, size_t> rules; //# of moves into noteIdx each rule ruled out, among the chords that contain its soprano note
+		size_t spanEnds = 0; //# of states at noteIdx that were legal but couldn't end their span on its waypoint or pivot
+	};
+
+	/*checks whether the plan has a bassline before any search starts. The live states are worked out backwards from 
+	the end, and if the start has none, the states reachable from the start are swept forwards to find the first note 
+	where they run out, tallying the rules that ruled out the moves into it. Both passes take time linear in the 
+	length of the soprano. Returns nothing if there is a bassline, and leaves the live states in the spans either way*/
+	std::optional<Conflict> findConflict(BassLinePlan& plan);
+
+	void printConflict(const Conflict& conflict, std::span<const Note> harmonizedLine);
+}
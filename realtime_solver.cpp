@@ -0,0 +1,42 @@
+#include "realtime_solver.h"
+
+namespace msc {
+	//the solver a plugin calls from its audio callback
+	template RealtimeResult solveRealtime<RT_PLUGIN_MAX_NOTES>(const RealtimeKey& key, std::span<const int> soprano,
+		                                                      const RealtimeStep& start, bool finalChord,
+		                                                      RealtimeScratch<RT_PLUGIN_MAX_NOTES>& scratch,
+		                                                      std::span<RealtimeStep> out) noexcept;
+}
+
+namespace {
+	//the written part of the soprano of a short phrase in D major, from the A over the opening D in the bass to the final D
+	constexpr std::array<int, 12> phraseSoprano{ 57, 59, 57, 55, 54, 52, 54, 55, 52, 50, 49, 50 };
+	constexpr msc::RealtimeStep phraseStart{ 0, msc::ROOT, 38 }; //I in root position over D
+
+	struct PhraseSolution {
+		msc::RealtimeResult result;
+		bool legal = true; //whether every move of the bassline follows the rules
+	};
+
+	/*solves the phrase at compile time, where anything the solver does that can't be done in a constant
+	expression, like throwing or touching a global, fails the build*/
+	constexpr PhraseSolution solvePhrase() {
+		msc::RealtimeKey key{ true, 2 };
+		msc::RealtimeScratch<msc::RT_PLUGIN_MAX_NOTES> scratch;
+		std::array<msc::RealtimeStep, phraseSoprano.size() - 1> out{};
+
+		PhraseSolution solution{ msc::solveRealtime(key, phraseSoprano, phraseStart, true, scratch, out) };
+		msc::RealtimeStep from = phraseStart;
+		for (size_t i = 0; i < out.size(); i++) {
+			solution.legal = solution.legal && msc::realtimeMoveLegal(key, from, phraseSoprano[i], out[i], phraseSoprano[i + 1],
+				                                                      i == out.size() - 1);
+			from = out[i];
+		}
+		return solution;
+	}
+
+	constexpr PhraseSolution phraseSolution = solvePhrase();
+	static_assert(phraseSolution.result.status == msc::RealtimeStatus::SOLVED, "the phrase has a bassline");
+	static_assert(phraseSolution.legal, "the bassline follows the rules");
+	static_assert(phraseSolution.result.steps <= msc::realtimeStepBound(phraseSoprano.size()), "the solver stays in its bound");
+}
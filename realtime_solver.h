@@ -0,0 +1,315 @@
+#pragma once
+
+#include <array>
+#include <span>
+#include <bit>
+#include <cstdint>
+
+#include "chord_vocabulary.h"
+#include "rules.h"
+
+/*
+* A build of the solver that can run in a real-time audio callback. It never allocates, locks or prints:
+* the keys are tables worked out at compile time from the vocabularies, every container has a fixed capacity
+* given by a template parameter, and the reachable states of each note live in a scratch buffer the caller
+* owns. The rules are the numeric ones of rules.h, so it accepts exactly the basslines the normal search does.
+*
+* Instead of the randomized backtracking of ChordTree, it marks the states each note can reach from the start,
+* then walks back from a random state of the last note, picking a random legal predecessor at each note.
+* That bounds the work by realtimeStepBound(), however unlucky the search is.
+* Everything is constexpr, and realtime_solver.cpp solves a phrase at compile time to hold it to that.
+*
+* A plugin keeps a RealtimeScratch<RT_PLUGIN_MAX_NOTES> next to its audio state, seeds its rng once, and calls 
+* solveRealtime from the callback with the soprano heard so far. That instantiation is compiled in 
+* realtime_solver.cpp; other window sizes instantiate the template themselves.
+*/
+namespace msc {
+	inline constexpr size_t RT_CHORD_COUNT = majorVocabulary.size();
+	static_assert(harmonicMinorVocabulary.size() == RT_CHORD_COUNT, "both modes need the same chord ids");
+
+	inline constexpr size_t RT_PITCH_COUNT = HIGHEST_BASS_PITCH - LOWEST_BASS_PITCH + 1;
+	inline constexpr size_t RT_STATE_COUNT = RT_CHORD_COUNT * MAX_CHORD_TONES * RT_PITCH_COUNT;
+
+	//# of octaves a pitch class can be in within the bass range
+	inline constexpr size_t RT_MAX_OCTAVES = (RT_PITCH_COUNT + 11) / 12;
+
+	//# of states that can follow a state, with every chord in every inversion and octave
+	inline constexpr size_t RT_MAX_MOVES = RT_CHORD_COUNT * MAX_CHORD_TONES * RT_MAX_OCTAVES;
+
+	//a chord of a mode, with its tones as pitch classes above the tonic
+	struct RealtimeChord {
+		int degree = 0;
+		size_t toneCount = 0;
+		std::array<int, MAX_CHORD_TONES> pitchClasses{};
+		std::array<bool, MAX_CHORD_TONES> leadingTone{}; //whether the tone is spelled as the leading tone
+		std::array<bool, MAX_CHORD_TONES> tonic{};       //whether the tone is spelled as the tonic
+		uint32_t destinations = 0; //ids of the chords this chord can move to
+	};
+
+	//the vocabulary of a mode, the same for every tonic
+	struct RealtimeTables {
+		std::array<RealtimeChord, RT_CHORD_COUNT> chords{};
+		std::array<uint32_t, 12> chordsWithPitchClass{}; //ids of the chords that contain each pitch class above the tonic
+	};
+
+	//builds the same chords as the Key constructor. Tones with the same letter and pitch class have the same name
+	constexpr RealtimeTables makeRealtimeTables(const std::array<ChordSpec, RT_CHORD_COUNT>& vocabulary) {
+		auto sameName = [](const ChordTone& a, const ChordTone& b) {
+			return a.letterSteps % 7 == b.letterSteps % 7 && a.halfSteps % 12 == b.halfSteps % 12;
+		};
+		auto idOfDegree = [&vocabulary](int degree) {
+			size_t id = 0;
+			while (id < vocabulary.size() && vocabulary[id].degree != degree) {
+				id++;
+			}
+			return id;
+		};
+
+		RealtimeTables tables;
+		for (size_t id = 0; id < vocabulary.size(); id++) {
+			const ChordSpec& spec = vocabulary[id];
+			RealtimeChord& chord = tables.chords[id];
+			chord.degree = spec.degree;
+			chord.toneCount = spec.toneCount;
+
+			for (size_t i = 0; i < spec.toneCount; i++) {
+				chord.pitchClasses[i] = spec.tones[i].halfSteps % 12;
+				chord.leadingTone[i] = sameName(spec.tones[i], vocabulary[6].tones[0]);
+				chord.tonic[i] = sameName(spec.tones[i], vocabulary[0].tones[0]);
+				tables.chordsWithPitchClass[static_cast<size_t>(chord.pitchClasses[i])] |= 1u << id;
+			}
+			for (int destination : spec.destinations) {
+				if (destination != 0) {
+					chord.destinations |= 1u << idOfDegree(destination);
+				}
+			}
+		}
+		return tables;
+	}
+
+	inline constexpr RealtimeTables majorTables = makeRealtimeTables(majorVocabulary);
+	inline constexpr RealtimeTables harmonicMinorTables = makeRealtimeTables(harmonicMinorVocabulary);
+
+	struct RealtimeKey {
+		const RealtimeTables* tables = &majorTables;
+		int tonicClass = 0; //pitch class of the tonic
+
+		constexpr RealtimeKey(bool major, int tonicClass) noexcept
+			: tables(major ? &majorTables : &harmonicMinorTables), tonicClass(((tonicClass % 12) + 12) % 12) {}
+
+		//pitch class of pitch above the tonic
+		constexpr int degreeClass(int pitch) const noexcept {
+			return (((pitch - tonicClass) % 12) + 12) % 12;
+		}
+	};
+
+	//# of soprano notes a plugin harmonizes at once, including the one under the start state
+	inline constexpr size_t RT_PLUGIN_MAX_NOTES = 32;
+
+	//a chord of the key over a bass note. The ids are the same as in Key, so steps convert to SolutionSteps as they are
+	struct RealtimeStep {
+		uint8_t chordId = 0;
+		uint8_t inversion = 0;
+		uint8_t pitch = LOWEST_BASS_PITCH;
+	};
+
+	constexpr size_t realtimeStateIndex(const RealtimeStep& step) noexcept {
+		return (static_cast<size_t>(step.chordId) * MAX_CHORD_TONES + step.inversion) * RT_PITCH_COUNT +
+			   static_cast<size_t>(step.pitch - LOWEST_BASS_PITCH);
+	}
+
+	constexpr RealtimeStep realtimeStateOfIndex(size_t idx) noexcept {
+		return { static_cast<uint8_t>(idx / (MAX_CHORD_TONES * RT_PITCH_COUNT)), static_cast<uint8_t>(idx / RT_PITCH_COUNT % MAX_CHORD_TONES),
+			     static_cast<uint8_t>(LOWEST_BASS_PITCH + static_cast<int>(idx % RT_PITCH_COUNT)) };
+	}
+
+	//whether the bass can move from one state to the next when the soprano moves from soprano to nextSoprano. The same checks as forEachMove
+	constexpr bool realtimeMoveLegal(const RealtimeKey& key, const RealtimeStep& from, int soprano, const RealtimeStep& to,
+		                             int nextSoprano, bool finalChord) noexcept
+	{
+		const RealtimeChord& fromChord = key.tables->chords[from.chordId];
+		const RealtimeChord& toChord = key.tables->chords[to.chordId];
+		uint32_t candidates = fromChord.destinations & key.tables->chordsWithPitchClass[static_cast<size_t>(key.degreeClass(nextSoprano))];
+		if ((candidates & (1u << to.chordId)) == 0 || to.inversion >= toChord.toneCount ||
+			key.degreeClass(to.pitch) != toChord.pitchClasses[to.inversion])
+		{
+			return false;
+		}
+
+		bool previousLeadingTone = fromChord.leadingTone[from.inversion];
+		return !inversionViolation(toChord.degree, to.inversion, toChord.toneCount, fromChord.degree, finalChord) &&
+			   !bassNameViolation(key.degreeClass(from.pitch), key.degreeClass(soprano), previousLeadingTone,
+				                  key.degreeClass(to.pitch), key.degreeClass(nextSoprano), toChord.tonic[to.inversion]) &&
+			   !bassPitchViolation(from.pitch, previousLeadingTone, from.inversion, nextSoprano - soprano, to.pitch);
+	}
+
+	/*most steps solveRealtime takes on a soprano of noteCount notes. A step is a visit of a state slot or a check of a move.
+	Going forward, each note visits every slot of the note before and checks every move out of a reachable one.
+	Going back, it visits every slot of the note before and checks the one move into the state picked after it*/
+	constexpr size_t realtimeStepBound(size_t noteCount) noexcept {
+		if (noteCount < 2) {
+			return 0;
+		}
+		return (noteCount - 1) * (RT_STATE_COUNT + RT_STATE_COUNT * RT_MAX_MOVES) + //forward
+			   RT_STATE_COUNT +                                                     //picking the last state
+			   (noteCount - 1) * (RT_STATE_COUNT * 2);                              //back
+	}
+
+	//a set of states. std::bitset isn't constexpr everywhere yet, so it's kept as plain words
+	struct RealtimeStateSet {
+		std::array<uint64_t, (RT_STATE_COUNT + 63) / 64> words{};
+
+		constexpr bool test(size_t idx) const noexcept {
+			return (words[idx / 64] >> (idx % 64)) & 1;
+		}
+		constexpr void set(size_t idx) noexcept {
+			words[idx / 64] |= uint64_t{ 1 } << (idx % 64);
+		}
+		constexpr void reset() noexcept {
+			words.fill(0);
+		}
+		constexpr bool none() const noexcept {
+			for (uint64_t word : words) {
+				if (word != 0) {
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+
+	//the same sequence as std::minstd_rand, written out so it can run at compile time
+	struct RealtimeRng {
+		uint32_t state = 1;
+
+		constexpr void seed(uint32_t value) noexcept {
+			state = value % 2147483647 == 0 ? 1 : value % 2147483647;
+		}
+		constexpr uint32_t operator()() noexcept {
+			state = static_cast<uint32_t>(uint64_t{ state } * 48271 % 2147483647);
+			return state;
+		}
+	};
+
+	//scratch space of solveRealtime for sopranos of up to MaxNotes notes, including the one under the start state
+	template<size_t MaxNotes>
+	struct RealtimeScratch {
+		std::array<RealtimeStateSet, MaxNotes> reachable{}; //states each note can reach from the start
+		RealtimeRng rng; //picks between solutions. Seed it to get different basslines
+	};
+
+	enum class RealtimeStatus {
+		SOLVED,
+		NO_SOLUTION,
+		TOO_LONG //the soprano doesn't fit the scratch or the output
+	};
+
+	struct RealtimeResult {
+		RealtimeStatus status = RealtimeStatus::NO_SOLUTION;
+		size_t steps = 0; //# of steps taken, never more than realtimeStepBound()
+	};
+
+	/*harmonizes soprano, a line of pitches. soprano[0] is the note over start, which is already written, and out[i] gets the
+	state under soprano[i + 1]. If finalChord is true, the last note ends the piece. Allocates, locks and prints nothing*/
+	template<size_t MaxNotes>
+	constexpr RealtimeResult solveRealtime(const RealtimeKey& key, std::span<const int> soprano, const RealtimeStep& start, bool finalChord,
+		                         RealtimeScratch<MaxNotes>& scratch, std::span<RealtimeStep> out) noexcept
+	{
+		RealtimeResult result;
+		if (soprano.size() > MaxNotes || out.size() + 1 < soprano.size()) {
+			result.status = RealtimeStatus::TOO_LONG;
+			return result;
+		}
+		if (soprano.size() < 2) {
+			result.status = RealtimeStatus::SOLVED;
+			return result;
+		}
+		if (start.chordId >= RT_CHORD_COUNT || start.inversion >= key.tables->chords[start.chordId].toneCount ||
+			start.pitch < LOWEST_BASS_PITCH || start.pitch > HIGHEST_BASS_PITCH) 
+		{
+			return result;
+		}
+
+		auto isFinal = [&](size_t noteIdx) {
+			return finalChord && noteIdx == soprano.size() - 1;
+		};
+
+		//mark the states each note can reach from the start
+		scratch.reachable[0].reset();
+		scratch.reachable[0].set(realtimeStateIndex(start));
+		for (size_t noteIdx = 1; noteIdx < soprano.size(); noteIdx++) {
+			RealtimeStateSet& reachable = scratch.reachable[noteIdx];
+			reachable.reset();
+
+			for (size_t stateIdx = 0; stateIdx < RT_STATE_COUNT; stateIdx++) {
+				result.steps++;
+				if (!scratch.reachable[noteIdx - 1].test(stateIdx)) {
+					continue;
+				}
+
+				RealtimeStep from = realtimeStateOfIndex(stateIdx);
+				const RealtimeChord& fromChord = key.tables->chords[from.chordId];
+				uint32_t candidates = fromChord.destinations &
+					                  key.tables->chordsWithPitchClass[static_cast<size_t>(key.degreeClass(soprano[noteIdx]))];
+				for (; candidates != 0; candidates &= candidates - 1) {
+					RealtimeStep to{ static_cast<uint8_t>(std::countr_zero(candidates)) };
+					const RealtimeChord& toChord = key.tables->chords[to.chordId];
+					for (to.inversion = 0; to.inversion < toChord.toneCount; to.inversion++) {
+						int pitchClass = (key.tonicClass + toChord.pitchClasses[to.inversion]) % 12;
+						for (int pitch = LOWEST_BASS_PITCH + (pitchClass - LOWEST_BASS_PITCH % 12 + 12) % 12;
+							 pitch <= HIGHEST_BASS_PITCH; pitch += 12)
+						{
+							result.steps++;
+							to.pitch = static_cast<uint8_t>(pitch);
+							if (realtimeMoveLegal(key, from, soprano[noteIdx - 1], to, soprano[noteIdx], isFinal(noteIdx))) {
+								reachable.set(realtimeStateIndex(to));
+							}
+						}
+					}
+				}
+			}
+
+			if (reachable.none()) {
+				return result;
+			}
+		}
+
+		//picks a state of a note uniformly from the ones accepted, seeing each one once
+		size_t seen = 0;
+		size_t picked = 0;
+		auto offer = [&](size_t stateIdx) {
+			seen++;
+			if (scratch.rng() % seen == 0) {
+				picked = stateIdx;
+			}
+		};
+
+		for (size_t stateIdx = 0; stateIdx < RT_STATE_COUNT; stateIdx++) {
+			result.steps++;
+			if (scratch.reachable[soprano.size() - 1].test(stateIdx)) {
+				offer(stateIdx);
+			}
+		}
+
+		//walk back, keeping a reachable state that moves into the one after it
+		for (size_t noteIdx = soprano.size() - 1; noteIdx > 0; noteIdx--) {
+			RealtimeStep to = realtimeStateOfIndex(picked);
+			out[noteIdx - 1] = to;
+
+			seen = 0;
+			for (size_t stateIdx = 0; stateIdx < RT_STATE_COUNT; stateIdx++) {
+				result.steps++;
+				if (!scratch.reachable[noteIdx - 1].test(stateIdx)) {
+					continue;
+				}
+				result.steps++;
+				if (realtimeMoveLegal(key, realtimeStateOfIndex(stateIdx), soprano[noteIdx - 1], to, soprano[noteIdx], isFinal(noteIdx))) {
+					offer(stateIdx);
+				}
+			}
+		}
+
+		result.status = RealtimeStatus::SOLVED;
+		return result;
+	}
+}
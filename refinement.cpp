@@ -0,0 +1,281 @@
+#include "refinement.h"
+
+int msc::transitionCost(const Note& fromBass, const Note& fromSoprano, 
+	                    const Chord& toChord, const Note& toBass, const Note& toSoprano)
+{
+	int bassMotion = toBass.pitch - fromBass.pitch;
+	int sopranoMotion = toSoprano.pitch - fromSoprano.pitch;
+
+	int cost = std::abs(bassMotion) <= 2 ? std::abs(bassMotion) : 2 * std::abs(bassMotion) - 2; //leaps cost double past a step
+	if (bassMotion == 0) {
+		cost += 2;
+	} else if (sopranoMotion != 0 && (bassMotion > 0) == (sopranoMotion > 0)) {
+		cost += 1; //contrary motion keeps the outer voices independent
+	}
+	if (toChord.inversion == SECOND) {
+		cost += 3;
+	} else if (toChord.inversion != ROOT) {
+		cost += 1;
+	}
+	return cost;
+}
+
+msc::BassLineRefiner::BassLineRefiner(const BassLinePlan& plan, const OutputData& solution) 
+	: m_plan(plan), m_soprano(plan.harmonizedLine()), m_steps(solution.steps), m_keys(solution.keys)
+{
+	if (m_plan.spans.empty()) {
+		return;
+	}
+	m_firstNoteIdx = m_plan.spans.front().startIdx + 1;
+
+	//a span's last chord is fixed if it pivots into the next key or is a waypoint
+	for (size_t spanIdx = 0; spanIdx < m_plan.spans.size(); spanIdx++) {
+		const KeySpan& span = m_plan.spans[spanIdx];
+		for (size_t noteIdx = span.startIdx + 1; noteIdx <= span.endIdx; noteIdx++) {
+			m_spanOf.push_back(spanIdx);
+			m_frozen.push_back(noteIdx == span.endIdx && (span.nextKey != nullptr || span.waypoint.has_value()));
+		}
+	}
+
+	for (size_t i = 0; i < m_steps.size(); i++) {
+		BassState previous = previousState(i);
+		size_t noteIdx = m_firstNoteIdx + i;
+		m_costs.push_back(transitionCost(previous.bass, m_soprano[noteIdx - 1], chordAt(i), bassAt(i), m_soprano[noteIdx]));
+		m_cost += m_costs.back();
+	}
+}
+
+const msc::Chord& msc::BassLineRefiner::chordAt(size_t stepIdx) const {
+	const SolutionStep& step = m_steps[stepIdx];
+	return m_keys[step.keyIdx]->chordOfId(step.chordId, step.inversion);
+}
+
+msc::Note msc::BassLineRefiner::bassAt(size_t stepIdx) const {
+	const SolutionStep& step = m_steps[stepIdx];
+	return { chordAt(stepIdx).notes[step.inversion].name, step.pitch, step.duration };
+}
+
+msc::BassState msc::BassLineRefiner::previousState(size_t stepIdx) const {
+	if (stepIdx == 0) {
+		return m_plan.start;
+	}
+
+	BassState previous{ chordAt(stepIdx - 1), bassAt(stepIdx - 1) };
+	const KeySpan& previousSpan = m_plan.spans[m_spanOf[stepIdx - 1]];
+	if (m_spanOf[stepIdx - 1] != m_spanOf[stepIdx] && previousSpan.nextKey != nullptr) {
+		int inversion = previous.chord.inversion;
+		previous.chord = *previousSpan.nextKey->pivotChord(previous.chord);
+		previous.chord.inversion = inversion;
+	}
+	return previous;
+}
+
+bool msc::BassLineRefiner::refineWindow(size_t startIdx, size_t endIdx) {
+	const Key& key = *m_plan.spans[m_spanOf[startIdx]].key;
+
+	//cheapest way into each state of each note of the window, found one note at a time
+	struct Entry {
+		const Chord* chord = nullptr;
+		Note bass;
+		int cost = 0;
+		size_t previous = 0; //entry of the note before
+	};
+	std::vector<std::vector<Entry>> layers(endIdx - startIdx);
+	std::vector<int> position(MAX_BASS_STATES, -1);
+
+	BassState start = previousState(startIdx);
+	for (size_t i = startIdx; i < endIdx; i++) {
+		size_t noteIdx = m_firstNoteIdx + i;
+		std::vector<Entry>& layer = layers[i - startIdx];
+		auto expand = [&](const Chord& chord, const Note& bass, int cost, size_t previous) {
+			forEachMove(key, chord, bass, m_soprano[noteIdx - 1], m_soprano[noteIdx], noteIdx == m_soprano.size() - 1, 
+				        [&](const Chord& next, const Note& nextBass) {
+				int nextCost = cost + transitionCost(bass, m_soprano[noteIdx - 1], next, nextBass, m_soprano[noteIdx]);
+				int& idx = position[stateIndex(next, nextBass.pitch)];
+				if (idx < 0) {
+					idx = static_cast<int>(layer.size());
+					layer.emplace_back(&next, nextBass, nextCost, previous);
+				} else if (nextCost < layer[static_cast<size_t>(idx)].cost) {
+					layer[static_cast<size_t>(idx)] = { &next, nextBass, nextCost, previous };
+				}
+			});
+		};
+
+		if (i == startIdx) {
+			expand(start.chord, start.bass, 0, 0);
+		} else {
+			const std::vector<Entry>& previousLayer = layers[i - startIdx - 1];
+			for (size_t j = 0; j < previousLayer.size(); j++) {
+				expand(*previousLayer[j].chord, previousLayer[j].bass, previousLayer[j].cost, j);
+			}
+		}
+		for (const Entry& entry : layer) {
+			position[stateIndex(*entry.chord, entry.bass.pitch)] = -1;
+		}
+	}
+
+	//the window has to lead into the step after it, which stays as it is
+	const std::vector<Entry>& lastLayer = layers.back();
+	std::optional<size_t> bestEntry;
+	int bestCost = 0;
+	for (size_t j = 0; j < lastLayer.size(); j++) {
+		int cost = lastLayer[j].cost;
+		if (endIdx < m_steps.size()) {
+			size_t noteIdx = m_firstNoteIdx + endIdx;
+			const Chord& nextChord = chordAt(endIdx);
+			Note nextBass = bassAt(endIdx);
+			bool legal = false;
+			forEachMove(key, *lastLayer[j].chord, lastLayer[j].bass, m_soprano[noteIdx - 1], m_soprano[noteIdx], noteIdx == m_soprano.size() - 1, 
+				        [&](const Chord& next, const Note& bass) {
+				legal = legal || (next.id == nextChord.id && next.inversion == nextChord.inversion && bass.pitch == nextBass.pitch);
+			});
+			if (!legal) {
+				continue;
+			}
+			cost += transitionCost(lastLayer[j].bass, m_soprano[noteIdx - 1], nextChord, nextBass, m_soprano[noteIdx]);
+		}
+		if (!bestEntry.has_value() || cost < bestCost) {
+			bestEntry = j;
+			bestCost = cost;
+		}
+	}
+
+	int currentCost = 0;
+	for (size_t i = startIdx; i <= endIdx && i < m_steps.size(); i++) {
+		currentCost += m_costs[i];
+	}
+	if (!bestEntry.has_value() || bestCost >= currentCost) {
+		return false;
+	}
+
+	//walk back through the window, writing the cheaper path over the old one
+	std::lock_guard lock{ m_mutex };
+	uint8_t keyIdx = m_steps[startIdx].keyIdx;
+	size_t entryIdx = bestEntry.value();
+	for (size_t i = endIdx; i-- > startIdx;) {
+		const Entry& entry = layers[i - startIdx][entryIdx];
+		m_steps[i] = { static_cast<uint8_t>(entry.chord->id), static_cast<uint8_t>(entry.chord->inversion), 
+			           static_cast<uint8_t>(entry.bass.pitch), keyIdx, m_soprano[m_firstNoteIdx + i].duration };
+		entryIdx = entry.previous;
+	}
+	for (size_t i = startIdx; i <= endIdx && i < m_steps.size(); i++) {
+		BassState previous = previousState(i);
+		size_t noteIdx = m_firstNoteIdx + i;
+		m_costs[i] = transitionCost(previous.bass, m_soprano[noteIdx - 1], chordAt(i), bassAt(i), m_soprano[noteIdx]);
+	}
+	m_cost += bestCost - currentCost;
+	m_improvements++;
+	return true;
+}
+
+void msc::BassLineRefiner::run(std::chrono::steady_clock::time_point deadline, std::stop_token stopToken) {
+	MSC_TRACE_SPAN("refine");
+
+	//steps that can start a window
+	std::vector<size_t> starts;
+	for (size_t i = 0; i < m_steps.size(); i++) {
+		if (!m_frozen[i]) {
+			starts.push_back(i);
+		}
+	}
+	if (starts.empty()) {
+		return;
+	}
+
+	std::uniform_int_distribution<size_t> startDist(0, starts.size() - 1);
+	std::uniform_int_distribution<size_t> lengthDist(1, MAX_REFINE_WINDOW);
+	while (!stopToken.stop_requested() && std::chrono::steady_clock::now() < deadline) {
+		MSC_TRACE_NODE();
+
+		//the window runs until its length, a fixed step or the end of its span
+		size_t startIdx = starts[startDist(m_rng)];
+		size_t endIdx = startIdx;
+		size_t length = lengthDist(m_rng);
+		while (endIdx < m_steps.size() && endIdx - startIdx < length && !m_frozen[endIdx] && m_spanOf[endIdx] == m_spanOf[startIdx]) {
+			endIdx++;
+		}
+		refineWindow(startIdx, endIdx);
+	}
+}
+
+msc::OutputData msc::BassLineRefiner::best() const {
+	std::lock_guard lock{ m_mutex };
+	OutputData data;
+	data.steps = m_steps;
+	data.keys = m_keys;
+	return data;
+}
+
+int msc::BassLineRefiner::cost() const {
+	std::lock_guard lock{ m_mutex };
+	return m_cost;
+}
+
+size_t msc::BassLineRefiner::improvements() const {
+	std::lock_guard lock{ m_mutex };
+	return m_improvements;
+}
+
+msc::OutputData msc::refineBassLine(const BassLinePlan& plan, const OutputData& solution, const SearchOptions& options) {
+	BassLineRefiner refiner{ plan, solution };
+	int startCost = refiner.cost();
+	refiner.run(std::chrono::steady_clock::now() + options.refineTime, options.stop);
+	std::cout << "Refined the bassline in " << refiner.improvements() << " moves, from a cost of " << startCost 
+		      << " to " << refiner.cost() << "\n";
+	return refiner.best();
+}
+
+int msc::bassLineCost(const BassLinePlan& plan, const OutputData& solution) {
+	return BassLineRefiner{ plan, solution }.cost();
+}
+
+std::optional<int> msc::cheapestCost(const BassLinePlan& plan) {
+	MSC_TRACE_SPAN("cheapest cost");
+	std::span<const Note> soprano = plan.harmonizedLine();
+
+	//cheapest way into each state of the note reached from the start
+	struct Entry {
+		const Chord* chord = nullptr;
+		Note bass;
+		int cost = 0;
+	};
+	std::vector<Entry> frontier{ { &plan.start.chord, plan.start.bass, 0 } };
+	std::vector<int> position(MAX_BASS_STATES, -1);
+
+	for (size_t i = 0; i < plan.spans.size(); i++) {
+		const KeySpan& span = plan.spans[i];
+		for (size_t noteIdx = span.startIdx; noteIdx < span.endIdx; noteIdx++) {
+			std::vector<Entry> next;
+			for (const Entry& entry : frontier) {
+				forEachMove(*span.key, *entry.chord, entry.bass, soprano[noteIdx], soprano[noteIdx + 1], noteIdx + 1 == soprano.size() - 1, 
+					        [&](const Chord& chord, const Note& bass) {
+					int cost = entry.cost + transitionCost(entry.bass, soprano[noteIdx], chord, bass, soprano[noteIdx + 1]);
+					int& idx = position[stateIndex(chord, bass.pitch)];
+					if (idx < 0) {
+						idx = static_cast<int>(next.size());
+						next.emplace_back(&chord, bass, cost);
+					} else {
+						next[static_cast<size_t>(idx)].cost = std::min(next[static_cast<size_t>(idx)].cost, cost);
+					}
+				});
+			}
+			for (const Entry& entry : next) {
+				position[stateIndex(*entry.chord, entry.bass.pitch)] = -1;
+			}
+			frontier = std::move(next);
+		}
+
+		//the span has to end on its waypoint and pivot into the next key
+		std::erase_if(frontier, [&](const Entry& entry) { return !acceptsSpanEnd(span, plan.pins[i], *entry.chord, entry.bass.pitch); });
+		if (span.nextKey != nullptr) {
+			for (Entry& entry : frontier) {
+				entry.chord = &span.nextKey->chordOfId(static_cast<size_t>(span.nextKey->pivotChord(*entry.chord)->id), entry.chord->inversion);
+			}
+		}
+	}
+
+	if (frontier.empty()) {
+		return {};
+	}
+	return std::ranges::min(frontier, {}, &Entry::cost).cost;
+}
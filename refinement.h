@@ -0,0 +1,74 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <stop_token>
+
+#include "bassline_maker.h"
+
+namespace msc {
+	inline constexpr size_t MAX_REFINE_WINDOW = 6; //# of notes re-solved at once
+
+	/*how much a move of the bass sounds worse than the smoothest one. Leaps cost more than steps, repeated 
+	bass notes and motion in the same direction as the soprano cost a little, and so do inverted chords*/
+	int transitionCost(const Note& fromBass, const Note& fromSoprano, 
+		               const Chord& toChord, const Note& toBass, const Note& toSoprano);
+
+	/*
+	* Improves a bassline that follows the rules without solving it again. Each move picks a random window 
+	* of up to MAX_REFINE_WINDOW notes inside one span and finds the cheapest way through it under the rules, 
+	* from the state before the window to the one after it. The window is replaced if that lowers the cost. 
+	* Only the transitions in and around the window are costed, so a move takes the same time however long 
+	* the bassline is. Chords at waypoints and key changes stay where they are.
+	* The bassline is only replaced by a cheaper one, so best() can be taken at any moment, from any thread.
+	*/
+	class BassLineRefiner {
+	private:
+		const BassLinePlan& m_plan;
+		std::span<const Note> m_soprano; //the harmonized line
+		size_t m_firstNoteIdx = 0;       //note of the first step
+
+		mutable std::mutex m_mutex; //guards the steps and cost, which best() reads
+		std::vector<SolutionStep> m_steps;
+		std::vector<const Key*> m_keys;
+		std::vector<int> m_costs; //cost of the move into each step
+		int m_cost = 0;
+		size_t m_improvements = 0;
+
+		std::vector<size_t> m_spanOf; //span of each step
+		std::vector<bool> m_frozen;   //steps the refinement can't change
+
+		std::mt19937 m_rng{ std::random_device{}() };
+
+		const Chord& chordAt(size_t stepIdx) const;
+		Note bassAt(size_t stepIdx) const;
+
+		//the state the step at stepIdx moves from, carried into its key
+		BassState previousState(size_t stepIdx) const;
+
+		//re-solves the steps [startIdx, endIdx). Returns true if it found a cheaper way through
+		bool refineWindow(size_t startIdx, size_t endIdx);
+	public:
+		//solution has to be written from plan
+		BassLineRefiner(const BassLinePlan& plan, const OutputData& solution);
+
+		//moves until the deadline passes or a stop is requested
+		void run(std::chrono::steady_clock::time_point deadline, std::stop_token stopToken = {});
+
+		//the cheapest bassline found so far
+		OutputData best() const;
+
+		int cost() const;
+		size_t improvements() const;
+	};
+
+	//sum of the transition costs of a bassline written from plan
+	int bassLineCost(const BassLinePlan& plan, const OutputData& solution);
+
+	//smooths a bassline written from plan for options.refineTime, unless a stop is requested first, and says how much it improved
+	OutputData refineBassLine(const BassLinePlan& plan, const OutputData& solution, const SearchOptions& options);
+
+	/*the cost of the cheapest bassline the plan allows, so no bassline written from it costs less. Sweeps the states 
+	forwards from the start, one note at a time, like findConflict. Returns nothing if the plan has no bassline*/
+	std::optional<int> cheapestCost(const BassLinePlan& plan);
+}
@@ -0,0 +1,53 @@
+#include "rules.h"
+
+std::string_view msc::ruleName(Rule rule) {
+	switch (rule) {
+	case Rule::FINAL_ROOT_POSITION:
+		return "the last chord must be in root position";
+	case Rule::AFTER_SIX_CHORD:
+		return "chords after a vi chord must be in root position";
+	case Rule::AFTER_SECONDARY_DOMINANT:
+		return "chords after a V/V can't be in third inversion";
+	case Rule::CHORD_INVERSION:
+		return "the chord can't be used in this inversion";
+	case Rule::CHORD_PROGRESSION:
+		return "the chord can't follow the previous chord";
+	case Rule::SOPRANO_NOT_IN_CHORD:
+		return "the chord doesn't contain the soprano note";
+	case Rule::BASS_NOT_IN_CHORD:
+		return "the bass note doesn't match the chord's inversion";
+	case Rule::DOUBLED_SOPRANO:
+		return "the bass and soprano have the same notes twice in a row";
+	case Rule::LEADING_TONE_RESOLUTION:
+		return "the leading tone must resolve up to the tonic";
+	case Rule::BASS_RANGE:
+		return "the bass is out of range";
+	case Rule::BASS_LEAP:
+		return "the bass leaps more than a fifth";
+	case Rule::BASS_TRITONE:
+		return "the bass leaps a tritone";
+	case Rule::SEVENTH_RESOLUTION:
+		return "the chordal seventh must resolve down";
+	case Rule::PARALLEL_FIFTHS:
+		return "parallel fifths";
+	}
+	return "";
+}
+
+std::optional<msc::Rule> msc::moveViolation(const Key& key, const Chord& chord, const Note& bass, const Note& soprano, 
+	                                        const Note& nextSoprano, bool finalChord, const Chord& next, const Note& nextBass)
+{
+	if (!chord.destinations.test(static_cast<size_t>(next.id))) {
+		return Rule::CHORD_PROGRESSION;
+	}
+	if (!key.candidates(chord, nextSoprano).test(static_cast<size_t>(next.id))) {
+		return Rule::SOPRANO_NOT_IN_CHORD;
+	}
+	if (auto rule = inversionViolation(next, chord.degree, finalChord)) {
+		return rule;
+	}
+	if (auto rule = bassNameViolation(key, bass, soprano, nextBass, nextSoprano)) {
+		return rule;
+	}
+	return bassPitchViolation(key, chord, bass, nextSoprano.pitch - soprano.pitch, nextBass);
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <optional>
+#include <string_view>
+
+#include "types.h"
+
+namespace msc {
+	//voice leading rules that every bassline has to follow
+	enum class Rule {
+		FINAL_ROOT_POSITION,      //the last chord must be in root position
+		AFTER_SIX_CHORD,          //chords after a vi chord must be in root position
+		AFTER_SECONDARY_DOMINANT, //chords after a V/V can't be in third inversion
+		CHORD_INVERSION,          //the chord can't be used in this inversion
+		CHORD_PROGRESSION,        //the chord can't follow the previous chord
+		SOPRANO_NOT_IN_CHORD,     //the chord doesn't contain the soprano note
+		BASS_NOT_IN_CHORD,        //the bass note isn't the chord tone of the inversion
+		DOUBLED_SOPRANO,          //the bass and soprano have the same notes twice in a row
+		LEADING_TONE_RESOLUTION,  //a leading tone in the bass must step up to the tonic
+		BASS_RANGE,               //the bass is out of its range
+		BASS_LEAP,                //the bass leaps more than a fifth
+		BASS_TRITONE,             //the bass leaps a tritone
+		SEVENTH_RESOLUTION,       //a seventh in the bass must step down
+		PARALLEL_FIFTHS           //the bass and soprano move in parallel fifths
+	};
+
+	std::string_view ruleName(Rule rule);
+
+	/*checks whether a chord of degree with toneCount tones, in its inversion, can follow a chord of previousDegree. 
+	Only takes numbers so it can run where strings can't (see realtime_solver.h)*/
+	constexpr std::optional<Rule> inversionViolation(int degree, int inversion, size_t toneCount, int previousDegree, bool finalChord) {
+		if (finalChord && inversion != 0) { //always make the last chord in root position
+			return Rule::FINAL_ROOT_POSITION;
+		}
+
+		//notes preceeded by a 6 chord must be in root position
+		if (previousDegree == 6 && inversion != 0) {
+			return Rule::AFTER_SIX_CHORD;
+		}
+
+		if (previousDegree == SECONDARY_DOM_DEGREE && inversion == 3) {
+			return Rule::AFTER_SECONDARY_DOMINANT;
+		}
+
+		//the bass has to be one of the chord's tones
+		if (static_cast<size_t>(inversion) >= toneCount) {
+			return Rule::CHORD_INVERSION;
+		}
+
+		bool valid = true;
+
+		switch (degree) {
+		case SECONDARY_DOM_DEGREE:
+			valid = inversion != THIRD; //no V of V chords with a 7th allowed
+			break;
+		case 1:
+			//6/4  and 3rd inversion 1 chords are banned!
+			valid = inversion != SECOND && inversion != THIRD;
+			break;
+		case 4:
+			valid = inversion != THIRD; //no 4 chords with a 7th
+			break;
+		case 6:
+			//six chord in first inversion must be preceeded by a V/V
+			if (inversion == FIRST) {
+				valid = previousDegree == SECONDARY_DOM_DEGREE;
+			} else { //otherwise, a 6 chord must be in root position
+				valid = inversion == ROOT && previousDegree != SECONDARY_DOM_DEGREE;
+			}
+			break;
+		case 7:
+			valid = inversion == FIRST; //seventh chords must be in 1st inversion
+			break;
+		case NEAPOLITAN_DEGREE:
+			valid = inversion == FIRST; //neapolitan sixths are always sixth chords
+			break;
+		case ITALIAN_SIXTH_DEGREE:
+		case FRENCH_SIXTH_DEGREE:
+		case GERMAN_SIXTH_DEGREE:
+			valid = inversion == ROOT; //the lowered sixth goes in the bass so it can fall to the dominant
+			break;
+		}
+
+		if (!valid) {
+			return Rule::CHORD_INVERSION;
+		}
+		return {};
+	}
+
+	//checks whether chord, in its inversion, can follow a chord of previousDegree
+	inline std::optional<Rule> inversionViolation(const Chord& chord, int previousDegree, bool finalChord) {
+		return inversionViolation(chord.degree, chord.inversion, chord.notes.size(), previousDegree, finalChord);
+	}
+
+	/*checks the rules that only depend on the names of the bass notes, on their pitch classes. 
+	previousLeadingTone and tonic say whether the bass notes are spelled as the leading tone and tonic of the key*/
+	constexpr std::optional<Rule> bassNameViolation(int previousBassClass, int previousSopranoClass, bool previousLeadingTone, 
+		                                            int bassClass, int sopranoClass, bool tonic) 
+	{
+		//the soprano and bass should never have the same note
+		if (bassClass == sopranoClass && previousBassClass == previousSopranoClass) {
+			return Rule::DOUBLED_SOPRANO;
+		}
+
+		//resolve the leading tone
+		if (previousLeadingTone && !tonic) {
+			return Rule::LEADING_TONE_RESOLUTION;
+		}
+
+		return {};
+	}
+
+	//checks the rules that only depend on the names of the bass notes, not their octaves
+	inline std::optional<Rule> bassNameViolation(const Key& key, const Note& previousBass, const Note& previousSoprano, 
+		                                         const Note& bass, const Note& soprano)
+	{
+		return bassNameViolation(pitchClass(previousBass), pitchClass(previousSoprano), previousBass.name == key.leadingTone().name, 
+			                     pitchClass(bass), pitchClass(soprano), bass.name == key.tonic().name);
+	}
+
+	/*checks the rules that depend on the pitch of the bass note, on numbers. previousInversion is 
+	the inversion of the chord that is being left and sopranoInterval is the motion of the soprano in halfsteps*/
+	constexpr std::optional<Rule> bassPitchViolation(int previousPitch, bool previousLeadingTone, int previousInversion, 
+		                                             int sopranoInterval, int pitch)
+	{
+		if (pitch > HIGHEST_BASS_PITCH || pitch < LOWEST_BASS_PITCH) {
+			return Rule::BASS_RANGE;
+		}
+
+		int bassInterval = pitch - previousPitch;
+		if (bassInterval > LARGEST_BASS_LEAP || bassInterval < -LARGEST_BASS_LEAP) {
+			return Rule::BASS_LEAP;
+		}
+		if (bassInterval == 6 || bassInterval == -6) { //forbid tritone
+			return Rule::BASS_TRITONE;
+		}
+		if (previousLeadingTone && bassInterval != 1) {
+			return Rule::LEADING_TONE_RESOLUTION;
+		}
+
+		//chordal seventh resolution test
+		if (previousInversion == 3 && bassInterval != -1) {
+			return Rule::SEVENTH_RESOLUTION;
+		}
+
+		if (bassInterval == sopranoInterval && sopranoInterval == 7) { //if we have parallel fifths
+			return Rule::PARALLEL_FIFTHS;
+		}
+
+		return {};
+	}
+
+	/*checks the rules that depend on the pitch of the bass note. previousChord is the chord 
+	that is being left and sopranoInterval is the motion of the soprano in halfsteps*/
+	inline std::optional<Rule> bassPitchViolation(const Key& key, const Chord& previousChord, const Note& previousBass, 
+		                                          int sopranoInterval, const Note& bass)
+	{
+		return bassPitchViolation(previousBass.pitch, previousBass.name == key.leadingTone().name, previousChord.inversion, 
+			                      sopranoInterval, bass.pitch);
+	}
+
+	/*returns the first rule that rules out moving from chord and bass to next over nextBass, in the order forEachMove 
+	checks them, or nothing if forEachMove would visit the move*/
+	std::optional<Rule> moveViolation(const Key& key, const Chord& chord, const Note& bass, const Note& soprano, 
+		                              const Note& nextSoprano, bool finalChord, const Chord& next, const Note& nextBass);
+
+	/*calls visit with every chord of key and bass note, in each legal octave, that can follow chord and bass 
+	when the soprano moves from soprano to nextSoprano*/
+	template<typename Visit>
+	void forEachMove(const Key& key, const Chord& chord, const Note& bass, const Note& soprano, const Note& nextSoprano, 
+		             bool finalChord, Visit&& visit) 
+	{
+		ChordSet candidates = key.candidates(chord, nextSoprano);
+		for (size_t id = 0; id < key.chordCount(); id++) {
+			if (!candidates.test(id)) {
+				continue;
+			}
+			for (size_t inversion = 0; inversion < key.chordOfId(id).notes.size(); inversion++) {
+				const Chord& next = key.chordOfId(id, static_cast<int>(inversion));
+				Note nextBass = next.notes[inversion];
+				if (inversionViolation(next, chord.degree, finalChord) || bassNameViolation(key, bass, soprano, nextBass, nextSoprano)) {
+					continue;
+				}
+
+				for (nextBass.pitch = LOWEST_BASS_PITCH + (pitchClass(nextBass) - LOWEST_BASS_PITCH % 12 + 12) % 12; 
+					 nextBass.pitch <= HIGHEST_BASS_PITCH; nextBass.pitch += 12) 
+				{
+					if (!bassPitchViolation(key, chord, bass, nextSoprano.pitch - soprano.pitch, nextBass)) {
+						visit(next, nextBass);
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,137 @@
+#include "solution_counter.h"
+
+#include <algorithm>
+
+msc::BigCount::BigCount(uint64_t value) {
+	for (; value > 0; value >>= 32) {
+		m_limbs.push_back(static_cast<uint32_t>(value));
+	}
+}
+
+msc::BigCount& msc::BigCount::operator+=(const BigCount& other) {
+	if (m_limbs.size() < other.m_limbs.size()) {
+		m_limbs.resize(other.m_limbs.size(), 0);
+	}
+
+	uint64_t carry = 0;
+	for (size_t i = 0; i < m_limbs.size() && (carry > 0 || i < other.m_limbs.size()); i++) {
+		uint64_t sum = carry + m_limbs[i] + (i < other.m_limbs.size() ? other.m_limbs[i] : 0);
+		m_limbs[i] = static_cast<uint32_t>(sum);
+		carry = sum >> 32;
+	}
+	if (carry > 0) {
+		m_limbs.push_back(static_cast<uint32_t>(carry));
+	}
+	return *this;
+}
+
+std::string msc::BigCount::toString() const {
+	if (m_limbs.empty()) {
+		return "0";
+	}
+
+	//divide by 10^9 over and over, collecting 9 digits at a time from the bottom
+	std::vector<uint32_t> remaining = m_limbs;
+	std::string digits;
+	while (!remaining.empty()) {
+		uint64_t remainder = 0;
+		for (size_t i = remaining.size(); i-- > 0;) {
+			uint64_t current = (remainder << 32) | remaining[i];
+			remaining[i] = static_cast<uint32_t>(current / 1'000'000'000);
+			remainder = current % 1'000'000'000;
+		}
+		while (!remaining.empty() && remaining.back() == 0) {
+			remaining.pop_back();
+		}
+
+		for (int i = 0; i < 9 && (!remaining.empty() || remainder > 0); i++) {
+			digits.push_back(static_cast<char>('0' + remainder % 10));
+			remainder /= 10;
+		}
+	}
+	std::ranges::reverse(digits);
+	return digits;
+}
+
+namespace {
+	//a state of the state graph and the # of valid partial basslines that end in it
+	struct CountedState {
+		msc::Chord chord;
+		msc::Note bass;
+		msc::BigCount count;
+	};
+}
+
+std::optional<msc::SolutionCount> msc::countBassLines(const std::vector<KeySegment>& keys, std::span<const Note> sopranoLine, 
+	                                                  std::span<const Note> bassLine, int finalDegree, int harmonicRhythm, 
+	                                                  const std::vector<HarmonyLabel>& waypoints)
+{
+	MSC_TRACE_SPAN("count basslines");
+
+	auto plan = planBassLine(keys, sopranoLine, bassLine, finalDegree, harmonicRhythm, waypoints);
+	if (!plan.has_value()) {
+		return {};
+	}
+
+	SolutionCount result;
+	if (plan->spans.empty()) {
+		result.total = 1; //the given bassline is the only one
+		return result;
+	}
+
+	std::span<const Note> soprano = plan->harmonizedLine();
+	std::vector<CountedState> current{ { plan->start.chord, plan->start.bass, 1 } };
+	std::vector<CountedState> next;
+	std::vector<int> nextIdx(MAX_BASS_STATES, -1); //position in next, or -1
+
+	for (size_t spanIdx = 0; spanIdx < plan->spans.size(); spanIdx++) {
+		const KeySpan& span = plan->spans[spanIdx];
+		const Key& key = *span.key;
+
+		for (size_t noteIdx = span.startIdx; noteIdx < span.endIdx; noteIdx++) {
+			const Note& fromSoprano = soprano[noteIdx];
+			const Note& toSoprano = soprano[noteIdx + 1];
+			bool finalChord = noteIdx + 1 == soprano.size() - 1;
+			PositionStats stats{ noteIdx + 1 };
+
+			for (const CountedState& from : current) {
+				forEachMove(key, from.chord, from.bass, fromSoprano, toSoprano, finalChord, [&](const Chord& to, const Note& bass) {
+					int& idx = nextIdx[stateIndex(to, bass.pitch)];
+					if (idx < 0) {
+						idx = static_cast<int>(next.size());
+						next.emplace_back(to, bass, BigCount{});
+					}
+					next[static_cast<size_t>(idx)].count += from.count;
+					stats.transitions++;
+				});
+			}
+
+			stats.states = next.size();
+			stats.branching = current.empty() ? 0 : static_cast<double>(stats.transitions) / static_cast<double>(current.size());
+			result.positions.push_back(stats);
+
+			for (const CountedState& state : next) {
+				nextIdx[stateIndex(state.chord, state.bass.pitch)] = -1;
+			}
+			std::swap(current, next);
+			next.clear();
+		}
+
+		//the last chord of a span has to match its waypoint and pin, and pivot into the next key, where it continues
+		std::erase_if(current, [&](const CountedState& state) {
+			return !acceptsSpanEnd(span, plan->pins[spanIdx], state.chord, state.bass.pitch);
+		});
+		if (span.nextKey != nullptr) {
+			for (CountedState& state : current) {
+				int inversion = state.chord.inversion;
+				state.chord = *span.nextKey->pivotChord(state.chord);
+				state.chord.inversion = inversion;
+			}
+		}
+	}
+
+	for (const CountedState& state : current) {
+		result.total += state.count;
+	}
+	return result;
+}
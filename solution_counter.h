@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bassline_maker.h"
+
+namespace msc {
+	//an unsigned integer of any size. Counts only ever get added together, so that is all it does
+	class BigCount {
+	private:
+		std::vector<uint32_t> m_limbs; //base 2^32, least significant first. Empty means 0
+	public:
+		BigCount() = default;
+		BigCount(uint64_t value);
+
+		BigCount& operator+=(const BigCount& other);
+
+		inline bool isZero() const {
+			return m_limbs.empty();
+		}
+		std::string toString() const;
+	};
+
+	//how much the search can branch at one harmonized note
+	struct PositionStats {
+		size_t noteIdx = 0;     //index in the harmonized soprano line
+		size_t states = 0;      //# of (chord, inversion, bass pitch) states a valid partial bassline reaches
+		size_t transitions = 0; //# of legal moves into those states from the previous note
+		double branching = 0;   //average # of legal moves out of each state of the previous note
+	};
+
+	struct SolutionCount {
+		BigCount total;
+		std::vector<PositionStats> positions;
+	};
+
+	/*
+	* Counts the basslines that follow every rule, through the same key spans, pivots and waypoints as writeBassLine. 
+	* Notes are swept left to right over the (note index, chord, inversion, bass pitch) state graph, adding the 
+	* count of each state into the states it can move to, so the time is linear in the length of the line.
+	* Unlike the search, which takes the first legal octave of a bass note, every legal octave is counted.
+	* Returns nothing if the score can't be planned.
+	*/
+	std::optional<SolutionCount> countBassLines(const std::vector<KeySegment>& keys, std::span<const Note> sopranoLine, 
+		                                        std::span<const Note> bassLine, int finalDegree, int harmonicRhythm = 0, 
+		                                        const std::vector<HarmonyLabel>& waypoints = {});
+}
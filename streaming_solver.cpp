@@ -0,0 +1,235 @@
+#include "streaming_solver.h"
+
+#include <random>
+
+#include "midi_writer.h"
+
+namespace {
+	constexpr int MAX_RELAXATION_LEVEL = 3;
+}
+
+msc::StreamingSolver::StreamingSolver(const Key* key, int startDegree, size_t lookahead, size_t frontierSize)
+	: m_key(key), m_startDegree(startDegree), m_lookahead(lookahead), m_frontierSize(std::max<size_t>(frontierSize, 1))
+{
+	if (key->chordOfDegree(startDegree) == nullptr) {
+		m_startDegree = 1;
+	}
+	m_frontier.emplace_back();
+}
+
+void msc::StreamingSolver::extend(const FrontierPath& path, const Note& soprano, int level, std::vector<FrontierPath>& next) const {
+	const Key& key = *m_key;
+
+	auto add = [&](size_t chordId, int inversion, int pitch, std::optional<Rule> relaxedRule) {
+		FrontierPath extended = path;
+		extended.steps.push_back({ static_cast<uint8_t>(chordId), static_cast<uint8_t>(inversion), static_cast<uint8_t>(pitch), relaxedRule });
+		extended.relaxations += relaxedRule.has_value();
+
+		//paths that end on the same state have the same future, so only the one with the fewest relaxations is kept
+		for (FrontierPath& other : next) {
+			if (other.steps.back().sameState(extended.steps.back())) {
+				if (extended.relaxations < other.relaxations) {
+					other = std::move(extended);
+				}
+				return;
+			}
+		}
+		next.push_back(std::move(extended));
+	};
+
+	//every octave of the bass note that is in range
+	auto forEachPitch = [](const Note& bass, auto&& visit) {
+		for (int pitch = LOWEST_BASS_PITCH + (pitchClass(bass) - LOWEST_BASS_PITCH % 12 + 12) % 12; pitch <= HIGHEST_BASS_PITCH; pitch += 12) {
+			visit(pitch);
+		}
+	};
+
+	const PathStep* from = !path.steps.empty() ? &path.steps.back() : m_lastCommitted ? &m_lastCommitted.value() : nullptr;
+	size_t windowIdx = path.steps.size();
+	const Note& fromSoprano = windowIdx > 0 ? m_window[windowIdx - 1] : m_lastCommittedSoprano;
+
+	ChordSet chords = key.candidates(soprano);
+
+	//the first note is harmonized by the starting chord if it can be, in root position
+	if (from == nullptr) {
+		const Chord* start = key.chordOfDegree(m_startDegree);
+		ChordSet firstChords = start != nullptr && chords.test(static_cast<size_t>(start->id)) ? 
+			                   ChordSet{}.set(static_cast<size_t>(start->id)) : chords;
+		for (size_t id = 0; id < key.chordCount(); id++) {
+			if (firstChords.test(id)) {
+				forEachPitch(key.chordOfId(id).notes[ROOT], [&](int pitch) { add(id, ROOT, pitch, {}); });
+			}
+		}
+		if (chords.none() && start != nullptr) {
+			forEachPitch(start->notes[ROOT], [&](int pitch) { 
+				add(static_cast<size_t>(start->id), ROOT, pitch, Rule::SOPRANO_NOT_IN_CHORD); 
+			});
+		}
+		return;
+	}
+
+	//at the last level, the previous chord and bass are held under the new soprano note
+	if (level == MAX_RELAXATION_LEVEL) {
+		add(from->chordId, from->inversion, from->pitch, Rule::SOPRANO_NOT_IN_CHORD);
+		return;
+	}
+
+	//the rules are checked on numbers, so nothing is copied for each move
+	const Chord& fromChord = key.chordOfId(from->chordId, from->inversion);
+	const Note& fromBass = fromChord.notes[from->inversion];
+	bool fromLeadingTone = fromBass.name == key.leadingTone().name;
+	int sopranoInterval = soprano.pitch - fromSoprano.pitch;
+	for (size_t id = 0; id < key.chordCount(); id++) {
+		if (!chords.test(id)) {
+			continue;
+		}
+		bool progression = fromChord.destinations.test(id);
+		if (level == 0 && !progression) {
+			continue;
+		}
+
+		for (size_t inversion = 0; inversion < key.chordOfId(id).notes.size(); inversion++) {
+			const Chord& chord = key.chordOfId(id, static_cast<int>(inversion));
+			const Note& bass = chord.notes[inversion];
+
+			auto inversionRule = inversionViolation(chord, fromChord.degree, false);
+			auto nameRule = bassNameViolation(pitchClass(fromBass), pitchClass(fromSoprano), fromLeadingTone, 
+				                              pitchClass(bass), pitchClass(soprano), bass.name == key.tonic().name);
+			forEachPitch(bass, [&](int pitch) {
+				auto violation = inversionRule ? inversionRule : nameRule ? nameRule : 
+					             bassPitchViolation(from->pitch, fromLeadingTone, from->inversion, sopranoInterval, pitch);
+				if (!violation && progression) {
+					add(id, chord.inversion, pitch, {});
+				} else if (!violation && level >= 1) {
+					add(id, chord.inversion, pitch, Rule::CHORD_PROGRESSION);
+				} else if (level >= 2) {
+					add(id, chord.inversion, pitch, violation ? violation : Rule::CHORD_PROGRESSION);
+				}
+			});
+		}
+	}
+}
+
+std::optional<msc::StreamStep> msc::StreamingSolver::push(const Note& soprano) {
+	MSC_TRACE_SPAN("stream step");
+
+	std::vector<FrontierPath> next;
+	for (int level = 0; level <= MAX_RELAXATION_LEVEL && next.empty(); level++) {
+		for (const FrontierPath& path : m_frontier) {
+			MSC_TRACE_NODE();
+			extend(path, soprano, level, next);
+		}
+	}
+	m_window.push_back(soprano);
+
+	//keep a random sample of the paths with the fewest relaxations, so the search stays varied like ChordTree's
+	static thread_local std::mt19937 rng{ std::random_device{}() };
+	std::ranges::shuffle(next, rng);
+	std::ranges::stable_sort(next, {}, &FrontierPath::relaxations);
+	if (next.size() > m_frontierSize) {
+		next.erase(next.begin() + static_cast<std::ptrdiff_t>(m_frontierSize), next.end());
+	}
+	m_frontier = std::move(next);
+
+	if (m_window.size() > m_lookahead) {
+		return commit();
+	}
+	return {};
+}
+
+msc::StreamStep msc::StreamingSolver::commit() {
+	//the best path decides the note, and every path that disagrees with it is dropped
+	PathStep committed = m_frontier.front().steps.front();
+	std::erase_if(m_frontier, [&committed](const FrontierPath& path) { return !path.steps.front().sameState(committed); });
+	for (FrontierPath& path : m_frontier) {
+		path.relaxations -= path.steps.front().relaxedRule.has_value();
+		path.steps.erase(path.steps.begin());
+	}
+
+	m_lastCommitted = committed;
+	m_lastCommittedSoprano = m_window.front();
+	m_window.erase(m_window.begin());
+
+	const Chord& chord = m_key->chordOfId(committed.chordId, committed.inversion);
+	return { &chord, Note{ chord.notes[committed.inversion].name, committed.pitch, m_lastCommittedSoprano.duration }, committed.relaxedRule };
+}
+
+std::vector<msc::StreamStep> msc::StreamingSolver::finish() {
+	std::vector<StreamStep> committed;
+	if (m_window.empty()) {
+		return committed;
+	}
+
+	//prefer the paths that end in root position, and report the rule if none do
+	auto rootPosition = std::ranges::stable_partition(m_frontier, 
+		[](const FrontierPath& path) { return path.steps.back().inversion == ROOT; });
+	if (rootPosition.begin() == m_frontier.begin() && !m_frontier.front().steps.back().relaxedRule.has_value()) {
+		m_frontier.front().steps.back().relaxedRule = Rule::FINAL_ROOT_POSITION;
+	}
+
+	while (!m_window.empty()) {
+		committed.push_back(commit());
+	}
+	return committed;
+}
+
+void msc::streamBassLine(std::istream& input, std::ostream& output, const Key& key, int startDegree, size_t lookahead) {
+	StreamingSolver solver{ &key, startDegree, lookahead };
+	std::optional<int> soundingBass; //MIDI note of the bass note that is playing
+	size_t committedCount = 0;
+
+	auto play = [&](const StreamStep& step) {
+		if (step.relaxedRule.has_value()) {
+			std::cerr << "Relaxed a rule at note " << committedCount + 1 << ": " << ruleName(step.relaxedRule.value()) << std::endl;
+		}
+		committedCount++;
+
+		int midiNote = std::clamp(step.bass.pitch + MIDI_PITCH_OFFSET, 0, 127);
+		if (soundingBass.has_value()) {
+			output.put(static_cast<char>(0x81)).put(static_cast<char>(soundingBass.value())).put(0);
+		}
+		output.put(static_cast<char>(0x91)).put(static_cast<char>(midiNote)).put(80);
+		output.flush();
+		soundingBass = midiNote;
+	};
+
+	//raw MIDI messages, with running status. Only note ons are read; every other message is skipped
+	uint8_t status = 0;
+	std::vector<uint8_t> data;
+	for (int next = input.get(); next != EOF; next = input.get()) {
+		uint8_t byte = static_cast<uint8_t>(next);
+		if (byte >= 0xF8) { //real time messages can come between any two bytes
+			continue;
+		}
+		if (byte & 0x80) {
+			status = byte >= 0xF0 ? 0 : byte;
+			data.clear();
+			continue;
+		}
+		if (status == 0) {
+			continue;
+		}
+
+		data.push_back(byte);
+		size_t length = (status & 0xF0) == 0xC0 || (status & 0xF0) == 0xD0 ? 1 : 2;
+		if (data.size() < length) {
+			continue;
+		}
+		if ((status & 0xF0) == 0x90 && data[1] > 0) {
+			Note soprano = key.spell(data[0] - MIDI_PITCH_OFFSET);
+			soprano.duration = 1;
+			if (auto step = solver.push(soprano)) {
+				play(step.value());
+			}
+		}
+		data.clear();
+	}
+
+	for (const StreamStep& step : solver.finish()) {
+		play(step);
+	}
+	if (soundingBass.has_value()) {
+		output.put(static_cast<char>(0x81)).put(static_cast<char>(soundingBass.value())).put(0);
+		output.flush();
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <istream>
+#include <ostream>
+#include <optional>
+#include <vector>
+
+#include "types.h"
+#include "rules.h"
+
+namespace msc {
+	inline constexpr size_t DEFAULT_LOOKAHEAD = 2;     //# of soprano notes heard before a bass note is committed
+	inline constexpr size_t DEFAULT_FRONTIER_SIZE = 64; //# of partial basslines kept between notes
+
+	//a committed chord and bass note. relaxedRule is set if no path followed every rule at this note
+	struct StreamStep {
+		const Chord* chord = nullptr; //in its inversion, owned by the key
+		Note bass;
+		std::optional<Rule> relaxedRule;
+	};
+
+	/*
+	* Harmonizes a soprano line that arrives one note at a time. 
+	* Instead of searching the whole line like ChordTree, it keeps a bounded frontier of basslines over 
+	* the last lookahead notes and commits the first note of the best one once a note falls out of the 
+	* window. Committed notes are never rewritten, so every step does at most a fixed amount of work: 
+	* frontier size * chords * inversions * octaves rule checks.
+	* If every path of the frontier dies, rules are relaxed one level at a time (chord progression, 
+	* then voice leading, then holding the previous chord) and the step reports the broken rule.
+	*/
+	class StreamingSolver {
+	private:
+		//a step of a path, packed like SolutionStep. The chord and bass note are looked up when it's committed
+		struct PathStep {
+			uint8_t chordId = 0;
+			uint8_t inversion = 0;
+			uint8_t pitch = 0; //of the bass note
+			std::optional<Rule> relaxedRule;
+
+			inline bool sameState(const PathStep& other) const {
+				return chordId == other.chordId && inversion == other.inversion && pitch == other.pitch;
+			}
+		};
+
+		//a bassline over the uncommitted notes
+		struct FrontierPath {
+			std::vector<PathStep> steps;
+			int relaxations = 0;
+		};
+
+		const Key* m_key = nullptr;
+		int m_startDegree = 1;
+		size_t m_lookahead = DEFAULT_LOOKAHEAD;
+		size_t m_frontierSize = DEFAULT_FRONTIER_SIZE;
+
+		std::vector<Note> m_window; //uncommitted soprano notes
+		std::optional<PathStep> m_lastCommitted;
+		Note m_lastCommittedSoprano;
+		std::vector<FrontierPath> m_frontier;
+
+		//adds the paths that harmonize soprano after path at the given relaxation level to next
+		void extend(const FrontierPath& path, const Note& soprano, int level, std::vector<FrontierPath>& next) const;
+		StreamStep commit();
+	public:
+		StreamingSolver(const Key* key, int startDegree, size_t lookahead = DEFAULT_LOOKAHEAD, 
+			            size_t frontierSize = DEFAULT_FRONTIER_SIZE);
+
+		//adds the next soprano note, returning the bass note it commits if the window is full
+		std::optional<StreamStep> push(const Note& soprano);
+
+		//ends the line on a root position chord and commits every note left in the window
+		std::vector<StreamStep> finish();
+	};
+
+	/*reads raw MIDI messages from input, treating every note on as the next soprano note, and writes
+	the committed bass notes to output as MIDI on channel 2. Relaxed rules are reported on std::cerr*/
+	void streamBassLine(std::istream& input, std::ostream& output, const Key& key, int startDegree, size_t lookahead);
+}
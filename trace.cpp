@@ -0,0 +1,332 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace {
+	struct TraceEvent {
+		const char* name = nullptr;
+		int64_t start = 0;    //microseconds since tracing started
+		int64_t duration = 0;
+		msc::AllocationCount allocations;
+		uint64_t nodes = 0; //search nodes expanded
+		msc::CounterValues counters{};
+	};
+
+	//events of one thread. Buffers are shared with the registry so they outlive their threads
+	struct ThreadBuffer {
+		int threadId = 0;
+		std::vector<TraceEvent> events;
+	};
+
+	std::mutex buffersMutex;
+	std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+	std::chrono::steady_clock::time_point traceStart;
+
+	std::atomic<msc::AllocationHook> allocationHook = nullptr;
+
+	thread_local msc::AllocationCount allocationCount;
+	thread_local bool recordingEvent = false; //keeps the trace's own allocations out of the counts
+
+	int64_t microsecondsSinceStart() {
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - traceStart).count();
+	}
+
+	ThreadBuffer& threadBuffer() {
+		thread_local std::shared_ptr<ThreadBuffer> buffer;
+		if (buffer == nullptr) {
+			std::lock_guard lock{ buffersMutex };
+			buffer = std::make_shared<ThreadBuffer>(static_cast<int>(buffers.size()) + 1);
+			buffers.push_back(buffer);
+		}
+		return *buffer;
+	}
+
+	void noteAllocation(size_t size) {
+		if (msc::tracingEnabled.load(std::memory_order_relaxed) && !recordingEvent) {
+			allocationCount.allocations++;
+			allocationCount.bytes += size;
+		}
+		if (auto hook = allocationHook.load(std::memory_order_relaxed)) {
+			hook(size);
+		}
+	}
+}
+
+msc::AllocationCount msc::threadAllocations() {
+	return allocationCount;
+}
+
+void msc::setAllocationHook(AllocationHook hook) {
+	allocationHook = hook;
+}
+
+void msc::startTracing(bool hardwareCounters) {
+	if (hardwareCounters && !readThreadCounters().has_value()) {
+		std::cout << "Hardware counters are unavailable here, so the trace has timing only\n";
+		hardwareCounters = false;
+	}
+	countersEnabled = hardwareCounters;
+	traceStart = std::chrono::steady_clock::now();
+	tracingEnabled = true;
+}
+
+void msc::TraceSpan::begin(const char* name) {
+	m_name = name;
+	m_startAllocations = allocationCount;
+	m_startNodes = expandedNodes;
+	if (countersEnabled.load(std::memory_order_relaxed)) {
+		m_startCounters = readThreadCounters().value_or(CounterValues{});
+	}
+	m_start = microsecondsSinceStart();
+}
+
+void msc::TraceSpan::end() {
+	int64_t now = microsecondsSinceStart();
+	CounterValues counters{};
+	if (countersEnabled.load(std::memory_order_relaxed)) {
+		counters = readThreadCounters().value_or(m_startCounters);
+		for (size_t i = 0; i < counters.size(); i++) {
+			counters[i] -= m_startCounters[i];
+		}
+	}
+	AllocationCount allocations{ allocationCount.allocations - m_startAllocations.allocations, 
+		                         allocationCount.bytes - m_startAllocations.bytes };
+
+	recordingEvent = true;
+	ThreadBuffer& buffer = threadBuffer();
+	buffer.events.emplace_back(m_name, m_start, now - m_start, allocations, expandedNodes - m_startNodes, counters); //only read once tracing is over
+	recordingEvent = false;
+}
+
+bool msc::writeTrace(const std::string& path) {
+	tracingEnabled = false;
+
+	std::ofstream file{ path };
+	if (!file) {
+		std::cout << "Error: couldn't write the trace to " << path << std::endl;
+		return false;
+	}
+
+	//totals of each span name, so the phases can be compared without opening a trace viewer
+	struct PhaseTotal {
+		size_t count = 0;
+		int64_t duration = 0;
+		AllocationCount allocations;
+		uint64_t nodes = 0;
+		CounterValues counters{};
+	};
+	std::map<std::string, PhaseTotal> phases;
+
+	//only the counters that opened are written, since the others read as 0
+	bool counters = countersEnabled.load();
+	uint32_t availableCounters = msc::availableCounters();
+	auto writeCounters = [&](const CounterValues& values, double scale) {
+		for (size_t i = 0; i < values.size(); i++) {
+			if (availableCounters & (1u << i)) {
+				file << ",\"" << counterName(static_cast<HardwareCounter>(i)) << "\":";
+				if (scale == 1) {
+					file << values[i];
+				} else {
+					file << static_cast<double>(values[i]) * scale;
+				}
+			}
+		}
+	};
+
+	std::lock_guard lock{ buffersMutex };
+
+	file << "{\"displayTimeUnit\":\"ms\",\"counters\":\"" << (counters ? "hardware" : "timing only") << "\",\"traceEvents\":[";
+	bool first = true;
+	for (const auto& buffer : buffers) {
+		for (const TraceEvent& event : buffer->events) {
+			file << (first ? "\n" : ",\n") << "{\"name\":\"" << event.name << "\",\"cat\":\"msc\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+				 << buffer->threadId << ",\"ts\":" << event.start << ",\"dur\":" << event.duration 
+				 << ",\"args\":{\"allocations\":" << event.allocations.allocations << ",\"bytes\":" << event.allocations.bytes;
+			if (event.nodes > 0) {
+				file << ",\"nodes\":" << event.nodes;
+			}
+			if (counters) {
+				writeCounters(event.counters, 1);
+			}
+			file << "}}";
+			first = false;
+
+			PhaseTotal& phase = phases[event.name];
+			phase.count++;
+			phase.duration += event.duration;
+			phase.allocations.allocations += event.allocations.allocations;
+			phase.allocations.bytes += event.allocations.bytes;
+			phase.nodes += event.nodes;
+			for (size_t i = 0; i < phase.counters.size(); i++) {
+				phase.counters[i] += event.counters[i];
+			}
+		}
+	}
+	file << "\n],\"phases\":{";
+
+	first = true;
+	for (const auto& [name, phase] : phases) {
+		file << (first ? "\n" : ",\n") << "\"" << name << "\":{\"count\":" << phase.count << ",\"durationUs\":" << phase.duration
+			 << ",\"allocations\":" << phase.allocations.allocations << ",\"bytes\":" << phase.allocations.bytes;
+		if (counters) {
+			writeCounters(phase.counters, 1);
+		}
+		//phases that expand search nodes are also measured per thousand of them, so searches of different sizes compare
+		if (phase.nodes > 0) {
+			double scale = 1000.0 / static_cast<double>(phase.nodes);
+			file << ",\"nodes\":" << phase.nodes << ",\"perThousandNodes\":{\"durationUs\":" << static_cast<double>(phase.duration) * scale
+				 << ",\"allocations\":" << static_cast<double>(phase.allocations.allocations) * scale;
+			if (counters) {
+				writeCounters(phase.counters, scale);
+			}
+			file << "}";
+		}
+		file << "}";
+		first = false;
+	}
+	file << "\n}}\n";
+
+	return true;
+}
+
+msc::TraceSession::TraceSession(std::string path, bool hardwareCounters) : m_path(std::move(path)) {
+	if (!m_path.empty()) {
+		startTracing(hardwareCounters);
+	}
+}
+
+msc::TraceSession::~TraceSession() {
+	if (!m_path.empty()) {
+		writeTrace(m_path);
+	}
+}
+
+#ifndef MSC_DISABLE_TRACING
+namespace {
+	void* alignedAllocate(std::size_t size, std::size_t alignment) {
+		size = (std::max<std::size_t>(size, 1) + alignment - 1) / alignment * alignment; //aligned_alloc wants a multiple
+#ifdef _WIN32
+		return _aligned_malloc(size, alignment);
+#else
+		return std::aligned_alloc(alignment, size);
+#endif
+	}
+
+	void alignedFree(void* ptr) {
+#ifdef _WIN32
+		_aligned_free(ptr);
+#else
+		std::free(ptr);
+#endif
+	}
+}
+
+//every allocation of the program goes through here so that spans can count them
+void* operator new(std::size_t size) {
+	noteAllocation(size);
+	if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+		return ptr;
+	}
+	throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size) {
+	return ::operator new(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+	noteAllocation(size);
+	if (void* ptr = alignedAllocate(size, static_cast<std::size_t>(alignment))) {
+		return ptr;
+	}
+	throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+	return ::operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	noteAllocation(size);
+	return std::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept {
+	return ::operator new(size, tag);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	noteAllocation(size);
+	return alignedAllocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t& tag) noexcept {
+	return ::operator new(size, alignment, tag);
+}
+
+/*the allocations above come from malloc, so they go back to free. GCC sees a pointer that the default 
+operator new could have made going to free and warns, which doesn't apply once operator new is replaced*/
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+	::operator delete(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+	::operator delete(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+	::operator delete(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+	::operator delete(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+	::operator delete(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+	alignedFree(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t alignment) noexcept {
+	::operator delete(ptr, alignment);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept {
+	::operator delete(ptr, alignment);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t alignment) noexcept {
+	::operator delete(ptr, alignment);
+}
+
+void operator delete(void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	::operator delete(ptr, alignment);
+}
+
+void operator delete[](void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	::operator delete(ptr, alignment);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#include "hardware_counters.h"
+
+/*Spans are recorded only after startTracing is called, so leaving them in costs a branch when 
+tracing is off. Define MSC_DISABLE_TRACING to compile them out completely, along with the 
+allocation counting in operator new. MSC_TRACE_NODE counts a node expanded by a search*/
+#ifdef MSC_DISABLE_TRACING
+#define MSC_TRACE_SPAN(name)
+#define MSC_TRACE_NODE()
+#else
+#define MSC_TRACE_CONCAT_(a, b) a##b
+#define MSC_TRACE_CONCAT(a, b) MSC_TRACE_CONCAT_(a, b)
+#define MSC_TRACE_SPAN(name) msc::TraceSpan MSC_TRACE_CONCAT(traceSpan, __LINE__){ name }
+#define MSC_TRACE_NODE() (msc::tracingEnabled.load(std::memory_order_relaxed) ? void(++msc::expandedNodes) : void())
+#endif
+
+namespace msc {
+	inline std::atomic<bool> tracingEnabled = false;
+	inline std::atomic<bool> countersEnabled = false; //spans read the hardware counters too
+
+	//search nodes expanded by the current thread while tracing is on
+	inline thread_local uint64_t expandedNodes = 0;
+
+	//heap allocations made by the current thread since it started, counted while tracing is on
+	struct AllocationCount {
+		uint64_t allocations = 0;
+		uint64_t bytes = 0;
+	};
+	AllocationCount threadAllocations();
+
+	//called by operator new for every allocation. Replace it to route allocations somewhere else too
+	using AllocationHook = void (*)(size_t bytes);
+	void setAllocationHook(AllocationHook hook);
+
+	/*with hardwareCounters, each span also reads the hardware counters of its thread when it starts and ends. 
+	That is a system call each time, so short spans get slower, but it shows where the cycles, branch misses and 
+	cache misses go. If the counters can't be opened the trace has timing only*/
+	void startTracing(bool hardwareCounters = false);
+
+	/*writes the spans recorded so far as Chrome trace event JSON, which can be opened in 
+	chrome://tracing or ui.perfetto.dev. Each span has the allocations made inside it in its args, and 
+	the search nodes and hardware counts if there are any. The totals of each phase are also given per 
+	thousand expanded search nodes*/
+	bool writeTrace(const std::string& path);
+
+	//records the time and allocations between its construction and destruction as a span of the trace
+	class TraceSpan {
+	private:
+		const char* m_name = nullptr; //nullptr if tracing was off when the span started
+		int64_t m_start = 0;
+		AllocationCount m_startAllocations;
+		uint64_t m_startNodes = 0;
+		CounterValues m_startCounters{};
+
+		void begin(const char* name);
+		void end();
+	public:
+		inline explicit TraceSpan(const char* name) {
+			if (tracingEnabled.load(std::memory_order_relaxed)) {
+				begin(name);
+			}
+		}
+		inline ~TraceSpan() {
+			if (m_name != nullptr) {
+				end();
+			}
+		}
+
+		TraceSpan(const TraceSpan&) = delete;
+		TraceSpan& operator=(const TraceSpan&) = delete;
+	};
+
+	//starts tracing if path isn't empty and writes the trace there when it goes out of scope
+	class TraceSession {
+	private:
+		std::string m_path;
+	public:
+		explicit TraceSession(std::string path, bool hardwareCounters = false);
+		~TraceSession();
+	};
+}
@@ -13,158 +13,133 @@ int msc::getInversion(const std::vector<Note>& notes, const Note& bass) {
 
 msc::Key::Key(KeyQuality quality, Note tonic)
 {
-	if (quality == KeyQuality::MAJOR) {
-		major = true;
-	} else {
-		major = false;
-	}
-
-	std::array<Note, 7> notes = { tonic }; //notes in the scale
-	std::ranges::fill(notes.begin() + 1, notes.end(), Note()); //fill all non-tonic notes with default values
-
-	auto setPitches = [&notes](const std::array<int, 7>& pitches) {
-		size_t intervalIdx = 0;
-		for (size_t i = 1; i < pitches.size(); i++, intervalIdx++) {
-			notes[i].pitch = notes[0].pitch + pitches[intervalIdx];
+	major = quality == KeyQuality::MAJOR;
+	const auto& vocabulary = major ? majorVocabulary : harmonicMinorVocabulary;
+
+	//letters in order from C, so the letter a number of steps above the tonic can be found by index
+	static constexpr std::array<char, 7> letters{ 'C', 'D', 'E', 'F', 'G', 'A', 'B' };
+	size_t tonicLetterIdx = static_cast<size_t>(std::distance(letters.begin(), std::ranges::find(letters, tonic.name[0])));
+
+	/*spell a chord tone by counting letters up from the tonic, then add accidentals until 
+	the natural pitch of the letter matches the pitch of the tone*/
+	auto spell = [&](const ChordTone& tone) {
+		char letter = letters[(tonicLetterIdx + static_cast<size_t>(tone.letterSteps)) % letters.size()];
+		Note note{ std::string{ letter }, tonic.pitch + tone.halfSteps };
+
+		int accidentals = ((note.pitch - pitches[letter]) % 12 + 12) % 12;
+		if (accidentals > 6) {
+			accidentals -= 12;
 		}
+		note.name.append(static_cast<size_t>(std::abs(accidentals)), accidentals > 0 ? '#' : 'b');
+		return note;
 	};
 
-	//Set pitches of each note depending on quality of key
-	if (quality == KeyQuality::MAJOR) {
-		setPitches(majorPitches);
-	} else {
-		setPitches(harmonicMinorPitches);
-	}
-	
-	/*find what letter the supertonic's name by finding position of
-	tonic's name in the pitch map and adding 1*/
-	auto noteNameIndex = pitches.begin();
-
-	for (auto it = pitches.begin(); it != pitches.end(); it++) {
-		if (tonic.name[0] == it->first) {
-			//make the next iterator the first element if we have reached the end of pitches
-			//otherwise just make the next iterator be the next element
-			if (std::next(it) == pitches.end()) { 
-				noteNameIndex = pitches.begin();
-			} else {
-				noteNameIndex = std::next(it);
-			}
-		}
-	}
+	auto idOfDegree = [&vocabulary](int degree) {
+		return static_cast<size_t>(std::distance(vocabulary.begin(), 
+			std::ranges::find(vocabulary, degree, &ChordSpec::degree)));
+	};
 
-	//pitches of the scale in sorted order, from do-ti
-	std::map<char, int> sortedPitches = { { tonic.name[0], pitches[tonic.name[0]] } };
+	for (size_t id = 0; id < vocabulary.size(); id++) {
+		const ChordSpec& spec = vocabulary[id];
+		auto chord = std::make_shared<Chord>();
+		chord->degree = spec.degree;
+		chord->id = static_cast<int>(id);
 
-	//give each note a name, ignoring accidentals. Add ordered scale degrees to sortedPitches
-	for (size_t i = 1; i < notes.size(); i++) {
-		if (noteNameIndex == pitches.end()) { //wrap back around to C 
-			noteNameIndex = pitches.begin();
+		for (size_t i = 0; i < spec.toneCount; i++) {
+			chord->notes.push_back(spell(spec.tones[i]));
+			m_chordsWithPitchClass[static_cast<size_t>(pitchClass(chord->notes.back()))].set(id);
 		}
-		char name = noteNameIndex->first;
-		notes[i].name = std::string{ name };
-
-		//add sorted name and pitch element
-		int pitch = pitches[name];
-		if (pitch < sortedPitches.rbegin()->second) { //add octave to make pitches sorted 
-			pitch += 12;
-		}
-		sortedPitches.emplace(name, pitch);
-		noteNameIndex++;
-	}
-
-	/*Add accidentals to each note name if the pitch of the given note
-	doesn't match the pitch in sortedPitches*/
-	for (Note& note : notes) {
-		int mapPitchDiff = sortedPitches[note.name[0]] - sortedPitches[notes[0].name[0]];
-		int scalePitchDiff = note.pitch - sortedPitches[notes[0].name[0]];
-		size_t accCount = std::abs(scalePitchDiff - mapPitchDiff); //# of accidentals to add
-
-		if (scalePitchDiff > mapPitchDiff) {
-			for (size_t i = 0; i < accCount; i++) {
-				note.name.push_back('#');
-			}
-		} else if (scalePitchDiff < mapPitchDiff) {
-			for (size_t i = 0; i < accCount; i++) {
-				note.name.push_back('b');
+		for (int destination : spec.destinations) {
+			if (destination != 0) {
+				chord->destinations.set(idOfDegree(destination));
 			}
 		}
-	}
 
-	//populate the chords
-	for (size_t i = 0; i < notes.size(); i++) {
-		size_t thirdIdx = (i + 2) % notes.size(); //idx of third of triad
-		size_t fifthIdx = (i + 4) % notes.size(); //idx of fifth of triad
-
-		if (i == 1 || i == 4) { //if we can write a seven chord with 2 or 5, add the seventh to the current chord
-			size_t seventhIdx = (i + 6) % notes.size();
-			m_chords[i] = std::make_shared<Chord>(
-				Chord{ static_cast<int>(i + 1), { notes[i], notes[thirdIdx], notes[fifthIdx], notes[seventhIdx] } }
-			);
-		} else { //otherwise, just make a plain chord with a root, third, and fifth
-			m_chords[i] = std::make_shared<Chord>(
-				Chord{ static_cast<int>(i + 1), { notes[i], notes[thirdIdx], notes[fifthIdx] } }
-			);
-		}
+		m_reachableChords |= chord->destinations;
+		m_chords.push_back(chord);
 	}
 
-	//generate special chords (just secondary dominant for now)
-	std::string secondDomName = notes[3].name;
-	if (notes[3].name.back() == 'b') {
-		secondDomName.pop_back();
-	} else {
-		secondDomName.push_back('#');
+	m_invertedChords.resize(m_chords.size() * MAX_CHORD_TONES);
+	for (size_t id = 0; id < m_chords.size(); id++) {
+		for (size_t inversion = 0; inversion < m_chords[id]->notes.size(); inversion++) {
+			Chord& inverted = m_invertedChords[id * MAX_CHORD_TONES + inversion];
+			inverted = *m_chords[id];
+			inverted.inversion = static_cast<int>(inversion);
+		}
 	}
-	m_secondaryDominant = std::make_shared<Chord>(
-		Chord { SECONDARY_DOM_DEGREE, { notes[1], { secondDomName, notes[3].pitch + 1 }, notes[5] } }
-	);
-
-	m_chords[0]->destinations = { m_chords[3].get(), m_chords[4].get(), m_chords[5].get(), m_chords[6].get(), m_secondaryDominant.get() };
-	m_chords[1]->destinations = { m_chords[4].get(), m_chords[6].get() };
-	m_chords[3]->destinations = { m_chords[0].get(), m_chords[1].get(), m_chords[4].get() };
-	m_chords[4]->destinations = { m_chords[0].get(), m_chords[5].get(), m_secondaryDominant.get() };
-	m_chords[5]->destinations = { m_chords[1].get(), m_chords[3].get(), m_chords[4].get() };
-	m_chords[6]->destinations = { m_chords[0].get() };
-	m_secondaryDominant->destinations = { m_chords[4].get(), m_chords[5].get() };
 }
 
 std::weak_ptr<msc::Chord> msc::Key::operator[](int idx) const {
 	return m_chords[static_cast<size_t>(idx)];
 }
 
-std::vector<std::weak_ptr<msc::Chord>> msc::Key::possibleChords(std::vector<Note> notes) const {
-	std::vector<std::weak_ptr<Chord>> candidates;
+const msc::Chord* msc::Key::chordOfDegree(int degree) const {
+	auto chord = std::ranges::find(m_chords, degree, &Chord::degree);
+	return chord != m_chords.end() ? chord->get() : nullptr;
+}
 
-	//checks to see whether the notes are part of a given chord
-	auto isContained = [notes](const Chord* chord) {
-		for (const Note& note : notes) { 
-			bool sameName = false;
-			for (const Note& chordNote : chord->notes) {
-				if (chordNote.name == note.name) {
-					sameName = true;
-					break;
-				}
-			}
-			if (!sameName) { //if note does not share a single name with the chord notes, return false
+const msc::Chord* msc::Key::pivotChord(const Chord& chord) const {
+	auto sameTriad = [&chord](const Chord* candidate) {
+		for (size_t i = 0; i < 3; i++) {
+			if (pitchClass(candidate->notes[i]) != pitchClass(chord.notes[i])) {
 				return false;
 			}
 		}
-		return true;
+		//the bass note of the chord's inversion has to exist in the pivot too
+		return static_cast<size_t>(chord.inversion) < candidate->notes.size();
 	};
 
-	//skip 3 chords
-	for (size_t i = 0; i < 2; i++) {
-		if (isContained(m_chords[i].get())) {
-			candidates.push_back(m_chords[i]);
+	for (const auto& candidate : m_chords) {
+		if (sameTriad(candidate.get())) {
+			return candidate.get();
 		}
 	}
-	for (size_t i = 3; i < 7; i++) {
-		if (isContained(m_chords[i].get())) {
-			candidates.push_back(m_chords[i]);
+
+	return nullptr;
+}
+
+msc::Note msc::Key::spell(int pitch) const {
+	//the scale's chords come first, so diatonic spellings win over chromatic ones
+	for (const auto& chord : m_chords) {
+		for (const Note& note : chord->notes) {
+			if (pitchClass(note) == ((pitch % 12) + 12) % 12) {
+				return { note.name, pitch };
+			}
 		}
 	}
-	if (isContained(m_secondaryDominant.get())) {
-		candidates.push_back(m_secondaryDominant);
+
+	static const std::array<std::string, 12> chromaticNames{ "C", "C#", "D", "Eb", "E", "F", "F#", "G", "Ab", "A", "Bb", "B" };
+	return { chromaticNames[static_cast<size_t>(((pitch % 12) + 12) % 12)], pitch };
+}
+
+std::shared_ptr<const msc::Key> msc::sharedKey(Key::KeyQuality quality, Note tonic) {
+	static std::mutex keysMutex;
+	static std::map<std::tuple<Key::KeyQuality, std::string, int>, std::shared_ptr<const Key>> keys;
+
+	std::lock_guard lock{ keysMutex };
+
+	auto& key = keys[{ quality, tonic.name, tonic.pitch }];
+	if (key == nullptr) {
+		MSC_TRACE_SPAN("key construction");
+		key = std::make_shared<const Key>(quality, tonic);
+	}
+	return key;
+}
+
+std::vector<std::weak_ptr<msc::Chord>> msc::Key::possibleChords(std::vector<Note> notes) const {
+	std::vector<std::weak_ptr<Chord>> candidates;
+
+	//keep the chords that contain every note, skipping the ones no chord moves to
+	ChordSet containing = m_reachableChords;
+	for (const Note& note : notes) {
+		containing &= m_chordsWithPitchClass[static_cast<size_t>(pitchClass(note))];
+	}
+
+	for (size_t id = 0; id < m_chords.size(); id++) {
+		if (containing.test(id)) {
+			candidates.push_back(m_chords[id]);
+		}
 	}
 
 	return candidates;
-}
\ No newline at end of file
+}
@@ -7,6 +7,14 @@
 #include <algorithm>
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <mutex>
+#include <tuple>
+#include <bitset>
+#include <cstdint>
+
+#include "chord_vocabulary.h"
+#include "trace.h"
 
 namespace msc {
 	inline std::map<char, int> pitches = {
@@ -26,40 +34,58 @@ namespace msc {
 	struct Note {
 		std::string name = "";
 		int pitch = 0;
-		int duration = 0; //whole = 16, half = 8, etc
+		int duration = 0; //measured in divisions of a quarter note (see Meter)
+	};
+
+	//time signature and the unit note durations are measured in
+	struct Meter {
+		int divisions = 4; //# of duration units in a quarter note
+		int beats = 4;
+		int beatType = 4;
+
+		inline int beatLength() const {
+			return divisions * 4 / beatType;
+		}
+		inline int measureLength() const {
+			return beats * beatLength();
+		}
 	};
 
+	inline int pitchClass(const Note& note) {
+		return ((note.pitch % 12) + 12) % 12;
+	}
+
 	inline constexpr int ROOT = 0;
 	inline constexpr int FIRST = 1;
 	inline constexpr int SECOND = 2;
 	inline constexpr int THIRD = 3;
 
+	//a set of chords of a key, indexed by their position in the key's vocabulary
+	using ChordSet = std::bitset<32>;
+
 	struct Chord {
 		int degree = 0;
 		std::vector<Note> notes;
-		std::vector<Chord*> destinations;
+		ChordSet destinations; //chords this chord can move to
 		int inversion = ROOT;
+		int id = -1; //position in the vocabulary of the key, the same for every key
 	};
 
 	int getInversion(const std::vector<Note>& chord, const Note& bass);
 
-	inline constexpr int SECONDARY_DOM_DEGREE = -1;
-
 	class Key {
 	private:
-		//distance in halfsteps of scale degrees from to tonic depending on key quality
-		static constexpr std::array<int, 7> majorPitches{
-			2, 4, 5, 7, 9, 11, 12
-		};
-		static constexpr std::array<int, 7> harmonicMinorPitches{
-			2, 3, 5, 7, 8, 11, 12
-		};
+		//chords of the vocabulary, in its order. The first 7 are the chords of the scale degrees
+		std::vector<std::shared_ptr<Chord>> m_chords;
 
-		//chords corresponding to scale degrees
-		std::array<std::shared_ptr<Chord>, 7> m_chords;
+		//a copy of each chord in each of its inversions, so searches can point at them instead of copying
+		std::vector<Chord> m_invertedChords;
 
-		//special chords
-		std::shared_ptr<Chord> m_secondaryDominant;
+		//chords that contain each pitch class
+		std::array<ChordSet, 12> m_chordsWithPitchClass;
+
+		//chords that some chord can move to. The others (iii) are never picked
+		ChordSet m_reachableChords;
 	public:
 		enum class KeyQuality {
 			MAJOR,
@@ -74,6 +100,59 @@ namespace msc {
 		std::weak_ptr<Chord> operator[](int idx) const;
 
 		std::vector<std::weak_ptr<Chord>> possibleChords(std::vector<Note> notes) const;
+
+		//returns the chords that can follow chord and contain the soprano note
+		inline ChordSet candidates(const Chord& chord, const Note& soprano) const {
+			return chord.destinations & m_chordsWithPitchClass[static_cast<size_t>(pitchClass(soprano))];
+		}
+		//returns the chords that some chord can move to and contain the soprano note
+		inline ChordSet candidates(const Note& soprano) const {
+			return m_reachableChords & m_chordsWithPitchClass[static_cast<size_t>(pitchClass(soprano))];
+		}
+
+		//returns the chord at the given position of the vocabulary
+		inline const Chord& chordOfId(size_t id) const {
+			return *m_chords[id];
+		}
+		inline const Chord& chordOfId(size_t id, int inversion) const {
+			return m_invertedChords[id * MAX_CHORD_TONES + static_cast<size_t>(inversion)];
+		}
+		inline size_t chordCount() const {
+			return m_chords.size();
+		}
+
+		//returns the chord with the given degree, or nullptr if the key has no such chord
+		const Chord* chordOfDegree(int degree) const;
+
+		/*returns the chord of this key with the same root, third and fifth as a chord of another key,
+		or nullptr if the chord can't pivot into this key*/
+		const Chord* pivotChord(const Chord& chord) const;
+
+		//returns a note of the given pitch, spelled as a note of the key's chords if it is in one
+		Note spell(int pitch) const;
+
+		inline const Note& tonic() const {
+			return m_chords[0]->notes[0];
+		}
+		inline const Note& leadingTone() const {
+			return m_chords[6]->notes[0];
+		}
+	};
+
+	//returns a key that is built once and shared by every segment and score that uses it
+	std::shared_ptr<const Key> sharedKey(Key::KeyQuality quality, Note tonic);
+
+	//a key that starts at a soprano note and lasts until the next segment
+	struct KeySegment {
+		size_t noteIdx = 0;
+		std::shared_ptr<const Key> key;
+	};
+
+	//a chord label written above a note
+	struct HarmonyLabel {
+		size_t noteIdx = 0; //index of the labeled note in its part
+		int degree = 0;
+		std::optional<int> inversion;
 	};
 
 	//inline Key BFlatMajor{ Key::KeyQuality::MAJOR, { "D", 2} };
@@ -0,0 +1,160 @@
+#include "validator.h"
+
+std::vector<msc::Violation> msc::validateBassLine(const Key& key, std::span<const Note> sopranoLine, std::span<const Note> bassLine,
+	                                              std::span<const CheckedChord> chords)
+{
+	std::vector<const Key*> keys(chords.size(), &key);
+	return validateBassLine(keys, sopranoLine, bassLine, chords);
+}
+
+std::vector<msc::Violation> msc::validateBassLine(std::span<const Key* const> keys, std::span<const Note> sopranoLine, 
+	                                              std::span<const Note> bassLine, std::span<const CheckedChord> chords)
+{
+	std::vector<Violation> violations;
+
+	size_t noteCount = std::min({ sopranoLine.size(), bassLine.size(), chords.size(), keys.size() });
+
+	for (size_t i = 1; i < noteCount; i++) {
+		const Key& key = *keys[i];
+		const Chord* previous = chords[i - 1].chord;
+		const Chord& current = *chords[i].chord;
+		int inversion = chords[i].inversion;
+
+		bool pivotFound = true;
+		if (keys[i] != keys[i - 1]) { //on a key change, the previous chord is read in the new key
+			const Chord* pivot = key.pivotChord(*previous);
+			pivotFound = pivot != nullptr;
+			if (pivotFound) {
+				previous = pivot;
+			}
+		}
+
+		auto report = [&](std::optional<Rule> rule) {
+			bool reported = !violations.empty() && violations.back().index == i && violations.back().rule == rule;
+			if (rule.has_value() && !reported) {
+				violations.emplace_back(i, rule.value());
+			}
+		};
+
+		//the chords the key allows after the previous chord
+		const Chord* keyChord = key.chordOfDegree(previous->degree);
+		if (!pivotFound) {
+			report(Rule::CHORD_PROGRESSION);
+		} else if (const Chord* currentKeyChord = key.chordOfDegree(current.degree); 
+			       keyChord != nullptr && (currentKeyChord == nullptr || !keyChord->destinations.test(static_cast<size_t>(currentKeyChord->id))))
+		{
+			report(Rule::CHORD_PROGRESSION);
+		}
+
+		//the chord has to contain the soprano, and the bass has to be the chord tone of the inversion
+		auto samePitchClass = [](const Note& note) { return [&note](const Note& chordNote) { return pitchClass(chordNote) == pitchClass(note); }; };
+		if (std::find_if(current.notes.begin(), current.notes.end(), samePitchClass(sopranoLine[i])) == current.notes.end()) {
+			report(Rule::SOPRANO_NOT_IN_CHORD);
+		}
+		if (static_cast<size_t>(inversion) >= current.notes.size() || current.notes[static_cast<size_t>(inversion)].name != bassLine[i].name) {
+			report(Rule::BASS_NOT_IN_CHORD);
+		}
+
+		report(inversionViolation(current.degree, inversion, current.notes.size(), previous->degree, i == sopranoLine.size() - 1));
+		report(bassNameViolation(key, bassLine[i - 1], sopranoLine[i - 1], bassLine[i], sopranoLine[i]));
+		report(bassPitchViolation(bassLine[i - 1].pitch, bassLine[i - 1].name == key.leadingTone().name, chords[i - 1].inversion, 
+			                      sopranoLine[i].pitch - sopranoLine[i - 1].pitch, bassLine[i].pitch));
+	}
+
+	return violations;
+}
+
+std::vector<msc::Violation> msc::validateLabeledBassLine(std::span<const KeySegment> keys, std::span<const Note> sopranoLine, 
+	                                                     std::span<const Note> bassLine, std::span<const HarmonyLabel> labels)
+{
+	MSC_TRACE_SPAN("validate");
+
+	if (labels.empty() || labels.front().noteIdx >= bassLine.size()) {
+		return {};
+	}
+
+	auto alignedSoprano = alignSopranoLine(sopranoLine, bassLine);
+
+	//onsets of the key segments, so that each bass note can be given the key it sounds in
+	std::vector<int> keyOnsets;
+	int onset = 0;
+	size_t sopranoIdx = 0;
+	for (const KeySegment& segment : keys) {
+		for (; sopranoIdx < segment.noteIdx && sopranoIdx < sopranoLine.size(); sopranoIdx++) {
+			onset += sopranoLine[sopranoIdx].duration;
+		}
+		keyOnsets.push_back(onset);
+	}
+
+	//the chords point into the keys. A label that isn't a chord of its key gets a chord with no tones, kept here
+	std::vector<Chord> unknownChords;
+	unknownChords.reserve(labels.size());
+
+	size_t firstIdx = labels.front().noteIdx;
+	std::vector<CheckedChord> chords;
+	std::vector<const Key*> noteKeys;
+	chords.reserve(bassLine.size() - firstIdx);
+	noteKeys.reserve(bassLine.size() - firstIdx);
+	auto labelIt = labels.begin();
+	CheckedChord chord;
+	size_t keyIdx = 0;
+	int bassOnset = 0;
+
+	for (size_t i = 0; i < bassLine.size(); i++) {
+		while (keyIdx + 1 < keys.size() && keyOnsets[keyIdx + 1] <= bassOnset) {
+			keyIdx++;
+		}
+		bassOnset += bassLine[i].duration;
+		if (i < firstIdx) {
+			continue;
+		}
+
+		const Key& key = *keys[keyIdx].key;
+		if (labelIt != labels.end() && labelIt->noteIdx == i) {
+			chord.chord = key.chordOfDegree(labelIt->degree);
+			if (chord.chord == nullptr) {
+				unknownChords.emplace_back().degree = labelIt->degree;
+				chord.chord = &unknownChords.back();
+			}
+			chord.inversion = labelIt->inversion.value_or(getInversion(chord.chord->notes, bassLine[i]));
+			labelIt++;
+		}
+		chords.push_back(chord);
+		noteKeys.push_back(&key);
+	}
+
+	auto violations = validateBassLine(noteKeys, std::span{ alignedSoprano }.subspan(firstIdx), bassLine.subspan(firstIdx), chords);
+	for (Violation& violation : violations) {
+		violation.index += firstIdx;
+	}
+
+	return violations;
+}
+
+std::vector<msc::Note> msc::alignSopranoLine(std::span<const Note> sopranoLine, std::span<const Note> bassLine) {
+	std::vector<Note> aligned;
+	aligned.reserve(bassLine.size());
+
+	size_t sopranoIdx = 0;
+	int sopranoEnd = sopranoLine.empty() ? 0 : sopranoLine[0].duration; //time the current soprano note stops
+	int bassOnset = 0;
+
+	for (const Note& bass : bassLine) {
+		while (sopranoIdx + 1 < sopranoLine.size() && sopranoEnd <= bassOnset) {
+			sopranoIdx++;
+			sopranoEnd += sopranoLine[sopranoIdx].duration;
+		}
+		if (sopranoIdx < sopranoLine.size()) {
+			aligned.push_back(sopranoLine[sopranoIdx]);
+		}
+		bassOnset += bass.duration;
+	}
+
+	return aligned;
+}
+
+void msc::printViolations(const std::vector<Violation>& violations) {
+	for (const Violation& violation : violations) {
+		std::cout << "Note " << violation.index << ": " << ruleName(violation.rule) << "\n";
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "rules.h"
+#include "parser.h"
+
+namespace msc {
+	//a rule broken by the bass note at index
+	struct Violation {
+		size_t index = 0;
+		Rule rule;
+	};
+
+	//a chord of the bassline being checked. The chord is shared, so its own inversion is ignored
+	struct CheckedChord {
+		const Chord* chord = nullptr;
+		int inversion = ROOT;
+	};
+
+	/*Checks a finished bassline against every rule the search uses, in a single pass. The soprano line, 
+	bass line and chords must line up note for note. The first note is treated as given, so only the moves 
+	away from it are checked.*/
+	std::vector<Violation> validateBassLine(const Key& key, std::span<const Note> sopranoLine, std::span<const Note> bassLine,
+		                                    std::span<const CheckedChord> chords);
+
+	//checks a bassline whose chords each belong to the key at the same index. On a key change, the previous chord has to pivot
+	std::vector<Violation> validateBassLine(std::span<const Key* const> keys, std::span<const Note> sopranoLine, 
+		                                    std::span<const Note> bassLine, std::span<const CheckedChord> chords);
+
+	/*Checks a parsed bass part against its harmony labels, starting at the first labeled note. A label 
+	holds until the next one, and labels without an inversion take it from the bass note. Each label is
+	read in the key segment the note sounds in. Indices of the violations are indices into bassLine.
+	Without a label on a bass note there is nothing to check, so that returns no violations*/
+	std::vector<Violation> validateLabeledBassLine(std::span<const KeySegment> keys, std::span<const Note> sopranoLine, 
+		                                           std::span<const Note> bassLine, std::span<const HarmonyLabel> labels);
+
+	//returns the soprano note that sounds at the start of each bass note
+	std::vector<Note> alignSopranoLine(std::span<const Note> sopranoLine, std::span<const Note> bassLine);
+
+	void printViolations(const std::vector<Violation>& violations);
+}